@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2018-2019, Lucas Lazare                                                                                                ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  		files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,  ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  		is furnished to do so, subject to the following conditions:                                                                 ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Headless micro-benchmarks of the message panel
+// usage: benchmark [frame count] [search line count]
+// draw: visible log lines are drawn as one text item per color run (PushStyleColor, TextUnformatted, SameLine, as the message
+//       panel used to), then as a single item per line whose runs are written to the window draw list (as it does now).
+//       Prints the CPU time per line (frame time minus that of an empty frame) and the vertices emitted per frame.
+// search: the log filter's substring search (ImTerm::search::find) against std::search, on the same lines, for a needle found
+//         near their end, one that is never found, and case insensitively.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imgui.h>
+
+#include "imterm/search.hpp"
+
+namespace {
+	constexpr int line_count = 40; // lines in view
+	constexpr int run_count = 4; // color runs per line
+
+	struct run {
+		std::size_t begin;
+		std::size_t end;
+		ImU32 color;
+	};
+
+	struct line {
+		std::string text;
+		std::vector<run> runs;
+	};
+
+	// 100 bytes: a timestamp, a level, text and a match
+	std::string make_text(int i) {
+		std::string text = "[12:34:56.789] [info] frame " + std::to_string(1000 + i) + " uploaded the vertex buffers of the scene, ";
+		text += "match";
+		text.resize(100u, '.');
+		return text;
+	}
+
+	std::vector<line> make_lines() {
+		const ImU32 colors[run_count] = {IM_COL32(128, 128, 128, 255), IM_COL32(80, 200, 80, 255), IM_COL32(230, 230, 230, 255), IM_COL32(255, 200, 0, 255)};
+		std::vector<line> lines(line_count);
+		for (int i = 0; i < line_count; ++i) {
+			line& l = lines[static_cast<std::size_t>(i)];
+			l.text = make_text(i);
+			const std::size_t bounds[run_count + 1] = {0u, 15u, 22u, 87u, 100u};
+			for (int r = 0; r < run_count; ++r) {
+				l.runs.push_back({bounds[r], bounds[r + 1], colors[r]});
+			}
+		}
+		return lines;
+	}
+
+	enum class mode {
+		empty,
+		items,
+		draw_list,
+	};
+
+	int draw_frame(mode m, const std::vector<line>& lines) {
+		ImGui::NewFrame();
+		ImGui::SetNextWindowPos(ImVec2(0.f, 0.f));
+		ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+		ImGui::Begin("benchmark", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+		ImDrawList* draw_list = ImGui::GetWindowDrawList();
+		const int first_vertex = draw_list->VtxBuffer.Size;
+
+		if (m == mode::items) {
+			for (const line& l : lines) {
+				for (const run& r : l.runs) {
+					ImGui::PushStyleColor(ImGuiCol_Text, r.color);
+					ImGui::TextUnformatted(l.text.data() + r.begin, l.text.data() + r.end);
+					ImGui::PopStyleColor();
+					ImGui::SameLine(0.f, 0.f);
+				}
+				ImGui::NewLine();
+			}
+		} else if (m == mode::draw_list) {
+			ImFont* font = ImGui::GetFont();
+			const float font_size = ImGui::GetFontSize();
+			for (const line& l : lines) {
+				ImVec2 pos = ImGui::GetCursorScreenPos();
+				ImGui::Dummy(ImVec2(ImGui::GetContentRegionAvail().x, font_size));
+				for (const run& r : l.runs) {
+					draw_list->AddText(font, font_size, pos, r.color, l.text.data() + r.begin, l.text.data() + r.end);
+					pos.x += font->CalcTextSizeA(font_size, std::numeric_limits<float>::max(), 0.f, l.text.data() + r.begin, l.text.data() + r.end).x;
+				}
+			}
+		}
+
+		const int vertices = draw_list->VtxBuffer.Size - first_vertex;
+		ImGui::End();
+		ImGui::Render();
+		return vertices;
+	}
+
+	// returns the mean frame time, in microseconds
+	double time_frames(mode m, const std::vector<line>& lines, int frames, int& vertices) {
+		for (int i = 0; i < 10; ++i) {
+			vertices = draw_frame(m, lines);
+		}
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; ++i) {
+			vertices = draw_frame(m, lines);
+		}
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+	}
+
+	// returns the mean time per line, in nanoseconds
+	template <typename Find>
+	double time_search(const std::vector<std::string>& texts, Find find, std::size_t& found) {
+		constexpr int rounds = 10;
+		found = 0u;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < rounds; ++i) {
+			for (const std::string& text : texts) {
+				found += find(text) ? 1u : 0u;
+			}
+		}
+		found /= rounds;
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (rounds * texts.size());
+	}
+
+	void compare_search(const std::vector<std::string>& texts, std::string_view needle, bool case_insensitive) {
+		auto std_find = [needle, case_insensitive](std::string_view text) {
+			if (case_insensitive) {
+				return std::search(text.cbegin(), text.cend(), needle.cbegin(), needle.cend(), [](char lhs, char rhs) {
+					return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+				}) != text.cend();
+			}
+			return std::search(text.cbegin(), text.cend(), needle.cbegin(), needle.cend()) != text.cend();
+		};
+		auto imterm_find = [needle, case_insensitive](std::string_view text) {
+			return ImTerm::search::contains(text, needle, case_insensitive);
+		};
+
+		std::size_t std_found{};
+		std::size_t imterm_found{};
+		const double std_ns = time_search(texts, std_find, std_found);
+		const double imterm_ns = time_search(texts, imterm_find, imterm_found);
+		std::printf("  \"%.*s\"%s: std::search %6.1f ns/line, search::find %6.1f ns/line (x%.1f)%s\n", static_cast<int>(needle.size()), needle.data(),
+		            case_insensitive ? " (case insensitive)" : "", std_ns, imterm_ns, std_ns / imterm_ns, std_found == imterm_found ? "" : ", results differ");
+	}
+}
+
+int main(int argc, char** argv) {
+	const int frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+	const int search_lines = argc > 2 ? std::atoi(argv[2]) : 100000;
+	if (frames <= 0 || search_lines <= 0) {
+		std::fprintf(stderr, "usage: %s [frame count] [search line count]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr;
+	io.DisplaySize = ImVec2(1280.f, 800.f);
+	io.DeltaTime = 1.f / 60.f;
+	unsigned char* pixels{};
+	int width{};
+	int height{};
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height); // builds the font atlas
+
+	const std::vector<line> lines = make_lines();
+	int vertices{};
+	const double empty_us = time_frames(mode::empty, lines, frames, vertices);
+	const double items_us = time_frames(mode::items, lines, frames, vertices);
+	const int items_vertices = vertices;
+	const double draw_list_us = time_frames(mode::draw_list, lines, frames, vertices);
+	const int draw_list_vertices = vertices;
+
+	std::printf("draw: %d lines of 100 bytes, %d color runs each, %d frames\n", line_count, run_count, frames);
+	std::printf("  text items: %7.3f us/line, %6d vertices/frame\n", (items_us - empty_us) / line_count, items_vertices);
+	std::printf("  draw list:  %7.3f us/line, %6d vertices/frame\n", (draw_list_us - empty_us) / line_count, draw_list_vertices);
+
+	std::vector<std::string> texts;
+	texts.reserve(static_cast<std::size_t>(search_lines));
+	for (int i = 0; i < search_lines; ++i) {
+		texts.push_back(make_text(i));
+	}
+	std::printf("search: %d lines of 100 bytes\n", search_lines);
+	compare_search(texts, "match", false);
+	compare_search(texts, "missing", false);
+	compare_search(texts, "MATCH", true);
+
+	ImGui::DestroyContext();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2018-2019, Lucas Lazare                                                                                                ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  		files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,  ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  		is furnished to do so, subject to the following conditions:                                                                 ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Minimal client for ImTerm::console_server
+// usage: console_client <socket path> [command...]
+// Given commands are sent one after the other, then messages are printed until the server stays silent for a second.
+// Without commands, lines read from the standard input are sent, and messages are printed until the server disconnects.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+	bool send_all(int fd, std::string_view text) {
+		while (!text.empty()) {
+			const ssize_t size = ::send(fd, text.data(), text.size(), 0);
+			if (size < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			text.remove_prefix(static_cast<std::size_t>(size));
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <socket path> [command...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (std::strlen(argv[1]) >= sizeof(address.sun_path)) {
+		std::fprintf(stderr, "%s: path too long\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	std::strcpy(address.sun_path, argv[1]);
+
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		std::fprintf(stderr, "%s: %s\n", argv[1], std::strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	const bool interactive = argc == 2;
+	for (int i = 2; i < argc; ++i) {
+		if (!send_all(fd, std::string{argv[i]} + '\n')) {
+			std::fprintf(stderr, "%s: %s\n", argv[1], std::strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	pollfd fds[] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+	const nfds_t fd_count = interactive ? 2 : 1;
+	char buffer[4096];
+	while (true) {
+		const int ready = ::poll(fds, fd_count, interactive ? -1 : 1000);
+		if (ready == 0) {
+			break; // silent server
+		}
+		if (ready < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			const ssize_t size = ::recv(fd, buffer, sizeof(buffer), 0);
+			if (size <= 0) {
+				break;
+			}
+			std::fwrite(buffer, 1, static_cast<std::size_t>(size), stdout);
+			std::fflush(stdout);
+		}
+		if (interactive && (fds[1].revents & (POLLIN | POLLHUP))) {
+			const ssize_t size = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+			if (size <= 0) {
+				fds[1].fd = -1; // stdin closed: only printing messages from now on
+			} else if (!send_all(fd, {buffer, static_cast<std::size_t>(size)})) {
+				break;
+			}
+		}
+	}
+	::close(fd);
+	return EXIT_SUCCESS;
+}
@@ -16,6 +16,8 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <imgui.h>
 #include <imgui-SFML.h>
@@ -25,6 +27,10 @@
 #include <spdlog/spdlog.h>
 
 #include "imterm/terminal.hpp"
+#ifdef __unix__
+#include "imterm/console_server.hpp"
+#include "imterm/history_file.hpp"
+#endif
 #include "terminal_commands.hpp"
 
 int main()
@@ -50,6 +56,22 @@ int main()
 	spdlog::set_level(spdlog::level::trace);
 	spdlog::default_logger()->sinks().push_back(terminal_log.get_terminal_helper());
 
+#ifdef __unix__
+	// the terminal may also be used with console_client (see console_client.cpp): ./ImTerm-Console-Client imterm.sock
+	ImTerm::console_server console;
+	if (!console.start("imterm.sock")) {
+		spdlog::error("Could not listen on imterm.sock: {}", std::strerror(errno));
+	}
+
+	// commands typed in previous sessions are available through the arrow keys and history references
+	auto history = std::make_shared<ImTerm::history_file>();
+	if (history->open("imterm_history.txt")) {
+		ImTerm::persist_history(terminal_log, history);
+	} else {
+		spdlog::error("Could not open imterm_history.txt: {}", std::strerror(errno));
+	}
+#endif
+
 	while(window.isOpen())
 	{
 		sf::Event event{};
@@ -68,6 +90,9 @@ int main()
 		}
 
 		ImGui::SFML::Update(window, deltaClock.restart());
+#ifdef __unix__
+		console.update(terminal_log);
+#endif
 
 		if (showing_term) {
 			if (frame_count % (30 * frame_mult) == 0) {
@@ -0,0 +1,218 @@
+#ifndef IMTERM_ANSI_HPP
+#define IMTERM_ANSI_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace ImTerm::ansi {
+
+	// Parsing of ANSI escape sequences, as written by programs coloring their output
+	// SGR sequences ("ESC[...m") set the colors and style of the following text: 16 colors, 256 colors and 24 bits colors are
+	// supported. Other sequences are dropped.
+
+	namespace details {
+		// colors are packed as 0xAARRGGBB, 0 being the default color
+		constexpr std::uint32_t rgb(unsigned char r, unsigned char g, unsigned char b) noexcept {
+			return 0xFF000000u | static_cast<std::uint32_t>(r) << 16u | static_cast<std::uint32_t>(g) << 8u | b;
+		}
+
+		// xterm's default colors
+		constexpr std::array<std::uint32_t, 16> palette{
+				rgb(0, 0, 0),       rgb(205, 0, 0),   rgb(0, 205, 0),   rgb(205, 205, 0),
+				rgb(0, 0, 238),     rgb(205, 0, 205), rgb(0, 205, 205), rgb(229, 229, 229),
+				rgb(127, 127, 127), rgb(255, 0, 0),   rgb(0, 255, 0),   rgb(255, 255, 0),
+				rgb(92, 92, 255),   rgb(255, 0, 255), rgb(0, 255, 255), rgb(255, 255, 255)};
+
+		// color of the 256 colors palette: 16 base colors, a 6x6x6 cube, then 24 grays
+		inline std::uint32_t color_256(unsigned index) noexcept {
+			if (index < 16u) {
+				return palette[index];
+			}
+			if (index < 232u) {
+				constexpr unsigned char levels[] = {0, 95, 135, 175, 215, 255};
+				index -= 16u;
+				return rgb(levels[index / 36u], levels[index / 6u % 6u], levels[index % 6u]);
+			}
+			const auto gray = static_cast<unsigned char>(8u + 10u * (std::min(index, 255u) - 232u));
+			return rgb(gray, gray, gray);
+		}
+
+		struct style {
+			std::uint32_t foreground{0u};
+			std::uint32_t background{0u};
+			std::uint8_t flags{0u};
+
+			bool operator==(const style& other) const noexcept {
+				return foreground == other.foreground && background == other.background && flags == other.flags;
+			}
+			bool operator!=(const style& other) const noexcept {
+				return !(*this == other);
+			}
+		};
+
+		// parses the extended color following a 38 or 48 parameter, ie: "5;n" or "2;r;g;b"
+		inline std::uint32_t extended_color(const std::vector<unsigned>& params, std::size_t& i) noexcept {
+			if (i + 2u < params.size() && params[i + 1u] == 5u) {
+				i += 2u;
+				return color_256(params[i]);
+			}
+			if (i + 4u < params.size() && params[i + 1u] == 2u) {
+				i += 4u;
+				auto channel = [&params](std::size_t j) {
+					return static_cast<unsigned char>(std::min(params[j], 255u));
+				};
+				return rgb(channel(i - 2u), channel(i - 1u), channel(i));
+			}
+			i = params.size(); // malformed: ignoring the remaining parameters
+			return 0u;
+		}
+
+		// applies the parameters of an SGR sequence, ie: "1;31" for "ESC[1;31m"
+		inline void apply_sgr(std::string_view sequence, style& st, std::vector<unsigned>& params) {
+			params.assign(1u, 0u);
+			for (char c : sequence) {
+				if (c == ';' || c == ':') {
+					params.push_back(0u);
+				} else if (c >= '0' && c <= '9') {
+					params.back() = std::min(params.back() * 10u + static_cast<unsigned>(c - '0'), 65'535u);
+				}
+			}
+
+			using flag = message::style_run::flag;
+			for (std::size_t i = 0u; i < params.size(); ++i) {
+				const unsigned param = params[i];
+				switch (param) {
+					case 0: st = {}; break;
+					case 1: st.flags |= flag::bold; break;
+					case 2: st.flags |= flag::dim; break;
+					case 3: st.flags |= flag::italic; break;
+					case 4: st.flags |= flag::underline; break;
+					case 7: st.flags |= flag::inverse; break;
+					case 9: st.flags |= flag::strikethrough; break;
+					case 22: st.flags &= static_cast<std::uint8_t>(~(flag::bold | flag::dim)); break;
+					case 23: st.flags &= static_cast<std::uint8_t>(~flag::italic); break;
+					case 24: st.flags &= static_cast<std::uint8_t>(~flag::underline); break;
+					case 27: st.flags &= static_cast<std::uint8_t>(~flag::inverse); break;
+					case 29: st.flags &= static_cast<std::uint8_t>(~flag::strikethrough); break;
+					case 38: st.foreground = extended_color(params, i); break;
+					case 39: st.foreground = 0u; break;
+					case 48: st.background = extended_color(params, i); break;
+					case 49: st.background = 0u; break;
+					default:
+						if (param >= 30u && param <= 37u) {
+							st.foreground = palette[param - 30u];
+						} else if (param >= 40u && param <= 47u) {
+							st.background = palette[param - 40u];
+						} else if (param >= 90u && param <= 97u) {
+							st.foreground = palette[param - 90u + 8u];
+						} else if (param >= 100u && param <= 107u) {
+							st.background = palette[param - 100u + 8u];
+						}
+						break;
+				}
+			}
+		}
+
+		// length of the escape sequence at the beginning of text (text[0] being ESC)
+		inline std::size_t sequence_length(std::string_view text) noexcept {
+			if (text.size() < 2u) {
+				return text.size();
+			}
+			if (text[1] == '[') { // CSI: parameters and intermediate bytes, then a final byte
+				std::size_t i = 2u;
+				while (i < text.size() && (text[i] < '@' || text[i] > '~')) {
+					++i;
+				}
+				return std::min(i + 1u, text.size());
+			}
+			if (text[1] == ']') { // OSC: ends with BEL or ESC backslash
+				for (std::size_t i = 2u; i < text.size(); ++i) {
+					if (text[i] == '\a') {
+						return i + 1u;
+					}
+					if (text[i] == '\x1b' && i + 1u < text.size() && text[i + 1u] == '\\') {
+						return i + 2u;
+					}
+				}
+				return text.size();
+			}
+			return 2u;
+		}
+	}
+
+	// removes the escape sequences of msg.value, and appends the colors and styles they set to runs, sorted by position
+	// msg.color_beg and msg.color_end are moved so as to keep pointing to the same text
+	inline void parse(message& msg, std::vector<message::style_run>& runs) {
+		std::string& text = msg.value;
+		std::size_t in = text.find('\x1b');
+		if (in == std::string::npos) {
+			return;
+		}
+
+		const std::size_t color_beg = msg.color_beg;
+		const std::size_t color_end = msg.color_end;
+		std::size_t out = in;
+		std::size_t run_begin = 0u;
+		details::style current{};
+		std::vector<unsigned> params;
+
+		auto end_run = [&] {
+			if (current != details::style{} && out > run_begin) {
+				runs.push_back({static_cast<std::uint32_t>(run_begin), static_cast<std::uint32_t>(out), current.foreground, current.background, current.flags});
+			}
+			run_begin = out;
+		};
+
+		while (in < text.size()) {
+			if (text[in] != '\x1b') {
+				text[out++] = text[in++];
+				continue;
+			}
+
+			const std::size_t length = details::sequence_length(std::string_view{text}.substr(in));
+			// positions within or after the sequence are moved back
+			for (auto [position, original] : {std::pair{&msg.color_beg, color_beg}, std::pair{&msg.color_end, color_end}}) {
+				if (original > in) {
+					*position -= std::min(original, in + length) - in;
+				}
+			}
+			if (length >= 3u && text[in + 1] == '[' && text[in + length - 1] == 'm') {
+				details::style next = current;
+				details::apply_sgr(std::string_view{text}.substr(in + 2u, length - 3u), next, params);
+				if (next != current) {
+					end_run();
+					current = next;
+				}
+			}
+			in += length;
+		}
+		end_run();
+		text.resize(out);
+	}
+}
+
+#endif //IMTERM_ANSI_HPP
@@ -0,0 +1,208 @@
+#ifndef IMTERM_COMMAND_OUTPUT_HPP
+#define IMTERM_COMMAND_OUTPUT_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "utils.hpp"
+#include "log_store.hpp"
+#include "ansi.hpp"
+#include "trace.hpp"
+
+namespace ImTerm {
+
+	// Output of commands, written as a stream: arg.out() << "latency: " << ms << "ms\n";
+	// Writes are appended to a single buffer, and only split in lines when flushed: the terminal flushes once per frame,
+	// logging every line with a single lock of the log store.
+	// A command writing more than spill_lines() lines has its whole output sent to the pager instead, so that it doesn't
+	// evict the scrollback.
+	// Not thread safe: meant to be written by commands, which run on the terminal's thread
+	class command_output {
+	public:
+		explicit command_output(std::size_t spill_lines = 1'000) : m_spill_lines{spill_lines} {}
+
+		command_output& write(std::string_view text) {
+			m_buffer.append(text);
+			return *this;
+		}
+
+		command_output& operator<<(std::string_view text) {
+			return write(text);
+		}
+
+		command_output& operator<<(const char* text) {
+			return write(text);
+		}
+
+		command_output& operator<<(char c) {
+			m_buffer.push_back(c);
+			return *this;
+		}
+
+		command_output& operator<<(bool b) {
+			return write(b ? "true" : "false");
+		}
+
+		template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+		command_output& operator<<(T value) {
+			std::array<char, 24> buffer{};
+			const std::to_chars_result result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+			m_buffer.append(buffer.data(), result.ptr);
+			return *this;
+		}
+
+		template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+		command_output& operator<<(T value) {
+			std::array<char, 32> buffer{};
+			const int length = std::snprintf(buffer.data(), buffer.size(), "%g", static_cast<double>(value));
+			m_buffer.append(buffer.data(), static_cast<std::size_t>(std::clamp(length, 0, static_cast<int>(buffer.size()) - 1)));
+			return *this;
+		}
+
+		// true if nothing is waiting to be flushed
+		bool empty() const noexcept {
+			return m_buffer.empty();
+		}
+
+		// ends the output of the current command, terminating its last line
+		void end_command() {
+			const std::size_t command_begin = m_command_ends.empty() ? 0u : m_command_ends.back();
+			if (m_buffer.size() > command_begin) {
+				if (m_buffer.back() != '\n') {
+					m_buffer.push_back('\n');
+				}
+				m_command_ends.push_back(m_buffer.size());
+			}
+		}
+
+		// logs the buffered lines to store, as terminal messages with info severity
+		// text written outside of commands is logged as soon as its line is complete, and is never sent to the pager
+		void flush(log_store& store) {
+			if (m_buffer.empty()) {
+				return;
+			}
+			IMTERM_TRACE_SCOPE("command_output::flush");
+
+			std::size_t begin = 0u;
+			for (std::size_t end : m_command_ends) {
+				split_lines(begin, end, true);
+				begin = end;
+			}
+			m_command_ends.clear();
+
+			const std::size_t last_line = m_buffer.rfind('\n');
+			if (last_line != std::string::npos && last_line >= begin) {
+				split_lines(begin, last_line + 1u, false);
+				begin = last_line + 1u;
+			}
+			m_buffer.erase(0u, begin);
+
+			store.push(std::move(m_lines), m_styles);
+			m_lines.clear();
+			m_styles.clear();
+		}
+
+		// maximum number of lines a single command may log, more than that sending its output to the pager
+		std::size_t spill_lines() const noexcept {
+			return m_spill_lines;
+		}
+
+		void set_spill_lines(std::size_t spill_lines) noexcept {
+			m_spill_lines = spill_lines;
+		}
+
+		// output of the last command that exceeded spill_lines(), without its escape sequences
+		bool has_pager() const noexcept {
+			return !m_pager_lines.empty();
+		}
+
+		std::size_t pager_line_count() const noexcept {
+			return m_pager_lines.size();
+		}
+
+		std::string_view pager_line(std::size_t index) const noexcept {
+			const std::size_t begin = m_pager_lines[index];
+			const std::size_t end = index + 1u < m_pager_lines.size() ? m_pager_lines[index + 1u] - 1u : m_pager.size();
+			return std::string_view{m_pager}.substr(begin, end - begin);
+		}
+
+		void close_pager() noexcept {
+			m_pager.clear();
+			m_pager_lines.clear();
+		}
+
+	private:
+		// splits [begin, end) in lines, end being right after a '\n'
+		void split_lines(std::size_t begin, std::size_t end, bool may_spill) {
+			const auto line_count = static_cast<std::size_t>(std::count(m_buffer.begin() + begin, m_buffer.begin() + end, '\n'));
+			if (may_spill && line_count > m_spill_lines) {
+				message text{};
+				text.value.assign(m_buffer, begin, end - begin - 1u);
+				std::vector<message::style_run> dropped_styles;
+				ansi::parse(text, dropped_styles);
+				m_pager = std::move(text.value);
+				m_pager_lines.assign(1u, 0u);
+				for (std::size_t i = m_pager.find('\n'); i != std::string::npos; i = m_pager.find('\n', i + 1u)) {
+					m_pager_lines.push_back(i + 1u);
+				}
+
+				add_line("[" + std::to_string(line_count) + " lines sent to the pager]");
+				return;
+			}
+
+			m_lines.reserve(m_lines.size() + line_count);
+			m_styles.reserve(m_styles.size() + line_count);
+			while (begin < end) {
+				const std::size_t line_end = m_buffer.find('\n', begin);
+				add_line(std::string_view{m_buffer}.substr(begin, line_end - begin));
+				begin = line_end + 1u;
+			}
+		}
+
+		void add_line(std::string_view text) {
+			message& msg = m_lines.emplace_back();
+			msg.severity = message::severity::info;
+			msg.value.assign(text);
+			msg.color_beg = 0u;
+			msg.color_end = 0u;
+			msg.is_term_message = true;
+			ansi::parse(msg, m_styles.emplace_back());
+		}
+
+		std::string m_buffer{};
+		std::vector<std::size_t> m_command_ends{}; // in m_buffer, right after the last line of each ended command
+		std::size_t m_spill_lines;
+
+		std::vector<message> m_lines{}; // being flushed
+		std::vector<std::vector<message::style_run>> m_styles{};
+
+		std::string m_pager{};
+		std::vector<std::size_t> m_pager_lines{}; // beginning of each line in m_pager
+	};
+}
+
+#endif //IMTERM_COMMAND_OUTPUT_HPP
@@ -0,0 +1,167 @@
+#ifndef IMTERM_COMMAND_REGISTRY_HPP
+#define IMTERM_COMMAND_REGISTRY_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ImTerm {
+
+	// Set of commands, sorted by name, which may be changed from any thread while being read without locking
+	//
+	// Readers go through an immutable snapshot of the commands, published atomically: writers copy the current snapshot,
+	// change the copy, then publish it. Replaced snapshots are kept until the reader declares it no longer references them
+	// (see quiesce), and are freed by the next writer.
+	//
+	// current() and quiesce() must be called by a single reader (typically, a terminal, see bind_reader): as quiesce() frees the
+	// snapshots that reader no longer references, a second reader could be left with freed ones. add() and remove() may be
+	// called from any thread: they only block each other.
+	template <typename Command>
+	class command_registry {
+	public:
+		struct snapshot {
+			std::uint64_t version;
+			std::vector<Command> commands; // sorted by name
+		};
+
+		command_registry() : m_current{new snapshot{0u, {}}} {}
+
+		// copies other's current commands. Concurrent writes to other may or may not be copied
+		command_registry(const command_registry& other) : m_current{new snapshot{0u, other.current().commands}} {}
+
+		// other should not be used after move
+		command_registry(command_registry&& other) noexcept
+			: m_current{other.m_current.exchange(nullptr)}
+			, m_reader_version{other.m_reader_version.load()}
+			, m_seen_version{other.m_seen_version}
+			, m_retired{std::move(other.m_retired)} {}
+
+		// assignments publish the new commands like add() and remove() do, so that the reader may keep the previous snapshot
+		// until its next quiesce()
+		command_registry& operator=(const command_registry& other) {
+			if (this != &other) {
+				replace(other.current().commands);
+			}
+			return *this;
+		}
+
+		// other should not be used after move
+		command_registry& operator=(command_registry&& other) {
+			if (this != &other) {
+				std::unique_ptr<snapshot> taken{const_cast<snapshot*>(other.m_current.exchange(nullptr))};
+				replace(taken ? std::move(taken->commands) : std::vector<Command>{}); // other may have been moved from already
+			}
+			return *this;
+		}
+
+		~command_registry() {
+			delete m_current.load();
+			for (const snapshot* retired : m_retired) {
+				delete retired;
+			}
+		}
+
+		// adds cmd, replacing the command having the same name if any
+		void add(const Command& cmd) {
+			std::lock_guard lock{m_writer_mutex};
+			const snapshot& previous = *m_current.load();
+			auto next = new snapshot{previous.version + 1u, previous.commands};
+			auto it = std::lower_bound(next->commands.begin(), next->commands.end(), cmd);
+			if (it != next->commands.end() && it->name == cmd.name) {
+				*it = cmd;
+			} else {
+				next->commands.insert(it, cmd);
+			}
+			publish(next);
+		}
+
+		// removes the command named name. Returns false if there is none
+		bool remove(std::string_view name) {
+			std::lock_guard lock{m_writer_mutex};
+			const snapshot& previous = *m_current.load();
+			auto it = std::lower_bound(previous.commands.cbegin(), previous.commands.cend(), name);
+			if (it == previous.commands.cend() || it->name != name) {
+				return false;
+			}
+			auto next = new snapshot{previous.version + 1u, {}};
+			next->commands.reserve(previous.commands.size() - 1u);
+			next->commands.insert(next->commands.end(), previous.commands.cbegin(), it);
+			next->commands.insert(next->commands.end(), std::next(it), previous.commands.cend());
+			publish(next);
+			return true;
+		}
+
+		// declares the reader of the commands. The reader isn't copied nor moved with the commands
+		void bind_reader(const void* reader) noexcept {
+			assert((m_reader == nullptr || m_reader == reader) && "commands can't be read by several terminals");
+			m_reader = reader;
+		}
+
+		// latest published commands. They stay valid until quiesce() returns true
+		const snapshot& current() const noexcept {
+			return *m_current.load();
+		}
+
+		// called regularly by the reader (ie: once per frame), so that older snapshots may be freed
+		// if it returns true, commands changed since the previous call, and the reader must drop the commands it got before this call
+		bool quiesce() noexcept {
+			const std::uint64_t version = m_current.load()->version;
+			// from now on, the reader only gets snapshots at least as recent as this one
+			m_reader_version.store(version);
+			return std::exchange(m_seen_version, version) != version;
+		}
+
+	private:
+		void replace(std::vector<Command> commands) {
+			std::lock_guard lock{m_writer_mutex};
+			publish(new snapshot{m_current.load()->version + 1u, std::move(commands)});
+		}
+
+		// requires m_writer_mutex
+		void publish(const snapshot* next) {
+			m_retired.push_back(m_current.exchange(next));
+
+			const std::uint64_t reader_version = m_reader_version.load();
+			m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [reader_version](const snapshot* retired) {
+				if (retired->version < reader_version) {
+					delete retired;
+					return true;
+				}
+				return false;
+			}), m_retired.end());
+		}
+
+		std::atomic<const snapshot*> m_current;
+		std::atomic<std::uint64_t> m_reader_version{0u}; // oldest version the reader may reference
+		std::uint64_t m_seen_version{0u}; // only used by the reader
+		const void* m_reader{nullptr}; // see bind_reader
+
+		std::mutex m_writer_mutex{};
+		std::vector<const snapshot*> m_retired{}; // requires m_writer_mutex
+	};
+}
+
+#endif //IMTERM_COMMAND_REGISTRY_HPP
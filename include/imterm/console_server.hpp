@@ -0,0 +1,353 @@
+#ifndef IMTERM_CONSOLE_SERVER_HPP
+#define IMTERM_CONSOLE_SERVER_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "terminal.hpp"
+#include "utf8.hpp"
+
+namespace ImTerm {
+
+	// Serves a terminal over a Unix domain socket, for when it can't be reached through its window (ie: fullscreen or headless)
+	// Clients send command lines, separated by '\n', executed as if typed by the user (see terminal::execute). Every message
+	// logged to the terminal is sent back to every client, followed by '\n'.
+	//
+	// Sockets are handled by a dedicated thread, with non-blocking I/O. The terminal's thread calls update() once per frame,
+	// executing received commands and handing new messages over in a single batch.
+	// Output pending for a client is capped to max_pending_bytes: messages are dropped for a client not reading fast enough,
+	// and replaced by a "[n messages dropped]" line once it caught up.
+	class console_server {
+	public:
+		explicit console_server(std::size_t max_pending_bytes = 1u << 20u) : m_max_pending_bytes{max_pending_bytes} {}
+
+		console_server(const console_server&) = delete;
+		console_server& operator=(const console_server&) = delete;
+
+		~console_server() {
+			stop();
+		}
+
+		// listens on path, replacing any existing socket file. Returns false if the socket couldn't be created (see errno)
+		bool start(std::string_view path) {
+			stop();
+			sockaddr_un address{};
+			if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+				errno = ENAMETOOLONG;
+				return false;
+			}
+			address.sun_family = AF_UNIX;
+			std::memcpy(address.sun_path, path.data(), path.size());
+
+			int pipe_fds[2];
+			if (::pipe(pipe_fds) != 0) {
+				return false;
+			}
+			m_wake_read = pipe_fds[0];
+			m_wake_write = pipe_fds[1];
+			m_listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (m_listener < 0 || !set_non_blocking(m_wake_read) || !set_non_blocking(m_wake_write) || !set_non_blocking(m_listener)) {
+				close_all();
+				return false;
+			}
+
+			m_path.assign(path);
+			::unlink(m_path.c_str());
+			if (::bind(m_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_listener, 8) != 0) {
+				close_all();
+				return false;
+			}
+
+			m_stop = false;
+			m_thread = std::thread{[this] { run(); }};
+			return true;
+		}
+
+		// closes every connection, and removes the socket file
+		void stop() {
+			if (m_thread.joinable()) {
+				m_stop = true;
+				wake();
+				m_thread.join();
+			}
+			close_all();
+		}
+
+		bool running() const noexcept {
+			return m_thread.joinable();
+		}
+
+		std::size_t client_count() const noexcept {
+			return m_client_count.load(std::memory_order_relaxed);
+		}
+
+		// to be called from the terminal's thread, once per frame
+		// executes the received commands, then sends the messages logged since the previous call
+		template <typename TerminalHelper>
+		void update(terminal<TerminalHelper>& term) {
+			std::vector<std::string> commands;
+			{
+				std::lock_guard lock{m_mutex};
+				commands.swap(m_commands);
+			}
+			for (const std::string& command : commands) {
+				term.execute(command);
+			}
+
+			log_store& store = *term.get_log_store();
+			std::lock_guard store_lock{store};
+			if (client_count() == 0u || !m_next_seq) {
+				m_next_seq = store.end_seq(); // clients only get messages logged after they connected
+				return;
+			}
+
+			batch out{};
+			if (*m_next_seq < store.first_seq()) {
+				out.count = static_cast<std::size_t>(store.first_seq() - *m_next_seq);
+				out.text = dropped_line(out.count); // dropped by the store before being sent
+				m_next_seq = store.first_seq();
+			}
+			for (; *m_next_seq < store.end_seq(); ++*m_next_seq) {
+				out.text += store.get(*m_next_seq).value;
+				out.text += '\n';
+				++out.count;
+			}
+			if (out.count == 0u) {
+				return;
+			}
+
+			{
+				std::lock_guard lock{m_mutex};
+				m_batches.push_back(std::move(out));
+			}
+			wake();
+		}
+
+	private:
+		struct batch {
+			std::string text;
+			std::size_t count{0u}; // number of messages
+		};
+
+		struct client {
+			int fd;
+			std::string input{}; // received text not ending with '\n' yet
+			std::string output{};
+			std::size_t output_pos{0u}; // output before output_pos was sent
+			std::size_t dropped{0u}; // messages not sent since output was full
+		};
+
+		static constexpr std::size_t max_line_size = 4096u;
+
+		static bool set_non_blocking(int fd) noexcept {
+			const int flags = ::fcntl(fd, F_GETFL, 0);
+			return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+		}
+
+		static std::string dropped_line(std::size_t count) {
+			return "[" + std::to_string(count) + " messages dropped]\n";
+		}
+
+		void wake() noexcept {
+			const char byte = 0;
+			[[maybe_unused]] const auto written = ::write(m_wake_write, &byte, 1); // the loop is already awake if the pipe is full
+		}
+
+		void close_all() noexcept {
+			for (int* fd : {&m_listener, &m_wake_read, &m_wake_write}) {
+				if (*fd >= 0) {
+					::close(*fd);
+					*fd = -1;
+				}
+			}
+			if (!m_path.empty()) {
+				::unlink(m_path.c_str());
+				m_path.clear();
+			}
+		}
+
+		// queues text for c, unless its pending output is full
+		void send(client& c, const batch& b) {
+			// dropping sent output once it is half of the buffer: the buffer stays under twice m_max_pending_bytes, even for a
+			// client that never catches up
+			if (c.output_pos * 2u >= c.output.size()) {
+				c.output.erase(0u, c.output_pos);
+				c.output_pos = 0u;
+			}
+			const std::size_t pending = c.output.size() - c.output_pos;
+			std::string dropped = c.dropped == 0u ? std::string{} : dropped_line(c.dropped);
+			if (pending + dropped.size() + b.text.size() > m_max_pending_bytes) {
+				c.dropped += b.count;
+				return;
+			}
+			c.output += dropped;
+			c.output += b.text;
+			c.dropped = 0u;
+		}
+
+		// returns false if c should be disconnected
+		bool receive(client& c) {
+			char buffer[4096];
+			while (true) {
+				const ssize_t size = ::recv(c.fd, buffer, sizeof(buffer), 0);
+				if (size == 0) {
+					return false;
+				}
+				if (size < 0) {
+					return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+				}
+
+				c.input.append(buffer, static_cast<std::size_t>(size));
+				std::size_t line_begin = 0u;
+				for (std::size_t end; (end = c.input.find('\n', line_begin)) != std::string::npos; line_begin = end + 1u) {
+					std::string line = c.input.substr(line_begin, end - line_begin);
+					if (!line.empty() && line.back() == '\r') {
+						line.pop_back();
+					}
+					if (!line.empty() && utf8::valid(line)) { // lines that are not valid UTF-8 are dropped
+						std::lock_guard lock{m_mutex};
+						m_commands.push_back(std::move(line));
+					}
+				}
+				c.input.erase(0u, line_begin);
+				if (c.input.size() > max_line_size) {
+					return false;
+				}
+			}
+		}
+
+		// returns false if c should be disconnected
+		bool flush(client& c) noexcept {
+			while (c.output_pos < c.output.size()) {
+#ifdef MSG_NOSIGNAL
+				const ssize_t size = ::send(c.fd, c.output.data() + c.output_pos, c.output.size() - c.output_pos, MSG_NOSIGNAL);
+#else
+				const ssize_t size = ::send(c.fd, c.output.data() + c.output_pos, c.output.size() - c.output_pos, 0);
+#endif
+				if (size < 0) {
+					return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+				}
+				c.output_pos += static_cast<std::size_t>(size);
+			}
+			return true;
+		}
+
+		void run() {
+			std::vector<client> clients;
+			std::vector<pollfd> fds;
+			std::vector<batch> batches;
+			while (!m_stop) {
+				fds.clear();
+				fds.push_back({m_wake_read, POLLIN, 0});
+				fds.push_back({m_listener, POLLIN, 0});
+				for (const client& c : clients) {
+					const bool pending = c.output_pos < c.output.size();
+					fds.push_back({c.fd, static_cast<short>(POLLIN | (pending ? POLLOUT : 0)), 0});
+				}
+				if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					break;
+				}
+
+				if (fds[0].revents & POLLIN) {
+					char buffer[64];
+					while (::read(m_wake_read, buffer, sizeof(buffer)) > 0) {}
+					{
+						std::lock_guard lock{m_mutex};
+						batches.swap(m_batches);
+					}
+					for (const batch& b : batches) {
+						for (client& c : clients) {
+							send(c, b);
+						}
+					}
+					batches.clear();
+				}
+
+				// fds[i + 2] is clients[i]'s. Clients accepted below are polled from the next iteration on
+				for (std::size_t i = clients.size(); i-- > 0u;) {
+					client& c = clients[i];
+					const short events = fds[i + 2u].revents;
+					bool connected = !(events & (POLLERR | POLLNVAL));
+					if (connected && (events & (POLLIN | POLLHUP))) {
+						connected = receive(c);
+					}
+					if (connected) {
+						connected = flush(c);
+					}
+					if (!connected) {
+						::close(c.fd);
+						clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+					}
+				}
+
+				if (fds[1].revents & POLLIN) {
+					int fd;
+					while ((fd = ::accept(m_listener, nullptr, nullptr)) >= 0) {
+						if (set_non_blocking(fd)) {
+							clients.push_back({fd});
+						} else {
+							::close(fd);
+						}
+					}
+				}
+				m_client_count.store(clients.size(), std::memory_order_relaxed);
+			}
+
+			for (const client& c : clients) {
+				::close(c.fd);
+			}
+			m_client_count.store(0u, std::memory_order_relaxed);
+		}
+
+		std::size_t m_max_pending_bytes;
+		std::string m_path{};
+		int m_listener{-1};
+		int m_wake_read{-1}; // written to wake the loop thread up
+		int m_wake_write{-1};
+		std::thread m_thread{};
+		std::atomic<bool> m_stop{false};
+		std::atomic<std::size_t> m_client_count{0u};
+
+		std::mutex m_mutex{};
+		std::vector<std::string> m_commands{}; // requires m_mutex
+		std::vector<batch> m_batches{}; // requires m_mutex
+
+		std::optional<log_store::seq_type> m_next_seq{}; // only used by the terminal's thread
+	};
+}
+
+#endif //IMTERM_CONSOLE_SERVER_HPP
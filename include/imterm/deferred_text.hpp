@@ -0,0 +1,99 @@
+#ifndef IMTERM_DEFERRED_TEXT_HPP
+#define IMTERM_DEFERRED_TEXT_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace ImTerm {
+
+	namespace details {
+		// only numbers and enums: any other argument could refer to memory that is gone by the time the text is formatted
+		template <typename T>
+		constexpr bool is_deferrable_arg = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+		// offsets of the arguments, stored one after the other. The last offset is the total size
+		template <typename... Args>
+		constexpr std::array<std::size_t, sizeof...(Args) + 1u> packed_offsets() noexcept {
+			std::array<std::size_t, sizeof...(Args) + 1u> offsets{};
+			std::size_t offset = 0u;
+			std::size_t i = 0u;
+			((offset = (offset + alignof(Args) - 1u) / alignof(Args) * alignof(Args), offsets[i++] = offset, offset += sizeof(Args)), ...);
+			offsets[i] = offset;
+			return offsets;
+		}
+	}
+
+	// Text of a message formatted only when it is read (see log_store::push_deferred): a format string and a copy of the
+	// arguments, so that messages that are never displayed nor searched are never formatted
+	// Arguments must be numbers or enums (see can_defer), and the format string must outlive the message (ie: a string literal)
+	class deferred_text {
+	public:
+		static constexpr std::size_t max_args_size = 48u;
+
+		template <typename... Args>
+		static constexpr bool can_defer = (details::is_deferrable_arg<Args> && ...) && details::packed_offsets<Args...>().back() <= max_args_size;
+
+		// Formatter::format(std::string& out, const char* format, const Args&... args) appends the formatted text to out
+		template <typename Formatter, typename... Args>
+		static deferred_text make(const char* format, const Args&... args) noexcept {
+			static_assert(can_defer<Args...>, "arguments must be numbers or enums");
+			static_assert(((alignof(Args) <= alignof(std::max_align_t)) && ...));
+
+			[[maybe_unused]] constexpr auto offsets = details::packed_offsets<Args...>();
+			deferred_text text{};
+			text.m_format_string = format;
+			text.m_format = &format_packed<Formatter, Args...>;
+			[[maybe_unused]] std::size_t i = 0u;
+			(std::memcpy(text.m_args.data() + offsets[i++], &args, sizeof(Args)), ...);
+			return text;
+		}
+
+		// appends the formatted text to out
+		void format(std::string& out) const {
+			m_format(m_format_string, m_args.data(), out);
+		}
+
+	private:
+		using format_function = void (*)(const char*, const unsigned char*, std::string&);
+
+		template <typename Formatter, typename... Args>
+		static void format_packed(const char* format, const unsigned char* args, std::string& out) {
+			unpack<Formatter, Args...>(format, args, out, std::index_sequence_for<Args...>{});
+		}
+
+		template <typename Formatter, typename... Args, std::size_t... Indexes>
+		static void unpack(const char* format, const unsigned char* args, std::string& out, std::index_sequence<Indexes...>) {
+			[[maybe_unused]] constexpr auto offsets = details::packed_offsets<Args...>();
+			Formatter::format(out, format, *std::launder(reinterpret_cast<const Args*>(args + offsets[Indexes]))...);
+		}
+
+		const char* m_format_string{};
+		format_function m_format{};
+		alignas(std::max_align_t) std::array<unsigned char, max_args_size> m_args{};
+	};
+}
+
+#endif //IMTERM_DEFERRED_TEXT_HPP
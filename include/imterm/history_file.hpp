@@ -0,0 +1,253 @@
+#ifndef IMTERM_HISTORY_FILE_HPP
+#define IMTERM_HISTORY_FILE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ImTerm {
+
+	// Command history kept in a file shared by every session, and every running instance, of the application (Unix only)
+	//
+	// Each entry is a line, appended in a single write under an exclusive lock: concurrent instances never interleave their
+	// entries. A line not ending with '\n' (an instance crashed while writing it, or a write was cut short) is truncated away
+	// under an exclusive lock when the file is opened, or right away by the instance whose write was cut short, so that it never
+	// merges with the next entry.
+	// Loading maps the file and reads it backward from its end, until max_entries distinct entries are found: as long as the file
+	// isn't mostly duplicates, it doesn't depend on the file's size. The file is compacted (keeping only these entries) when loaded
+	// if it is more than twice as big as them, by writing a new file and renaming it over the previous one under an exclusive lock.
+	// Appending reopens the file if it was replaced in the meantime.
+	class history_file {
+	public:
+		explicit history_file(std::size_t max_entries = 10000u) : m_max_entries{max_entries} {}
+
+		history_file(const history_file&) = delete;
+		history_file& operator=(const history_file&) = delete;
+
+		~history_file() {
+			close();
+		}
+
+		// opens the file at path, creating it if needed. Returns false if it couldn't be opened (see errno)
+		bool open(std::string_view path) {
+			close();
+			m_path.assign(path);
+			return reopen();
+		}
+
+		void close() noexcept {
+			if (m_fd >= 0) {
+				::close(m_fd);
+				m_fd = -1;
+			}
+		}
+
+		bool is_open() const noexcept {
+			return m_fd >= 0;
+		}
+
+		// returns the latest max_entries distinct entries, oldest first
+		std::vector<std::string> load() {
+			std::vector<std::string> entries;
+			if (m_fd < 0 || ::flock(m_fd, LOCK_SH) != 0) {
+				return entries;
+			}
+			const std::size_t file_size = read_latest(entries);
+			::flock(m_fd, LOCK_UN);
+
+			std::size_t kept_size = 0u;
+			for (const std::string& entry : entries) {
+				kept_size += entry.size() + 1u;
+			}
+			if (file_size > 2u * kept_size + compaction_slack) {
+				compact();
+			}
+			return entries;
+		}
+
+		// appends line to the file. Returns false if it couldn't be written, or if line is empty or contains a '\n'
+		bool append(std::string_view line) {
+			if (m_fd < 0 || line.empty() || line.find('\n') != std::string_view::npos) {
+				return false;
+			}
+			std::string record;
+			record.reserve(line.size() + 1u);
+			record += line;
+			record += '\n';
+
+			// exclusive, so that nothing is appended between a write cut short and its trimming
+			while (::flock(m_fd, LOCK_EX) == 0) {
+				if (!replaced()) {
+					const ssize_t size = ::write(m_fd, record.data(), record.size());
+					if (size > 0 && static_cast<std::size_t>(size) < record.size()) {
+						trim_partial_line();
+					}
+					::flock(m_fd, LOCK_UN);
+					return size == static_cast<ssize_t>(record.size());
+				}
+				if (!reopen()) { // closing the replaced file released its lock
+					return false;
+				}
+			}
+			return false;
+		}
+
+		// rewrites the file with only the entries load() returns. Returns false on failure (see errno)
+		bool compact() {
+			if (m_fd < 0 || ::flock(m_fd, LOCK_EX) != 0) {
+				return false;
+			}
+			if (replaced()) {
+				return reopen(); // compacted by another instance
+			}
+
+			std::vector<std::string> entries;
+			read_latest(entries);
+			std::string text;
+			for (const std::string& entry : entries) {
+				text += entry;
+				text += '\n';
+			}
+
+			const std::string temporary = m_path + ".tmp" + std::to_string(::getpid());
+			const int out = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+			bool written = out >= 0;
+			for (std::size_t pos = 0u; written && pos < text.size();) {
+				const ssize_t size = ::write(out, text.data() + pos, text.size() - pos);
+				written = size > 0 || (size < 0 && errno == EINTR);
+				pos += size > 0 ? static_cast<std::size_t>(size) : 0u;
+			}
+			written = written && ::fsync(out) == 0;
+			if (out >= 0) {
+				::close(out);
+			}
+			if (!written || ::rename(temporary.c_str(), m_path.c_str()) != 0) {
+				::unlink(temporary.c_str());
+				::flock(m_fd, LOCK_UN);
+				return false;
+			}
+			return reopen(); // closing the previous file releases its lock
+		}
+
+	private:
+		static constexpr std::size_t compaction_slack = 1u << 16u;
+
+		bool reopen() {
+			close();
+			m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+			if (m_fd < 0) {
+				return false;
+			}
+			if (::flock(m_fd, LOCK_EX) == 0) {
+				trim_partial_line();
+				::flock(m_fd, LOCK_UN);
+			}
+			return true;
+		}
+
+		// truncates the file after its last '\n'. Requires the exclusive lock
+		void trim_partial_line() const noexcept {
+			struct stat info{};
+			if (::fstat(m_fd, &info) != 0) {
+				return;
+			}
+			char chunk[4096];
+			off_t end = info.st_size;
+			while (end > 0) {
+				const off_t begin = end > static_cast<off_t>(sizeof(chunk)) ? end - static_cast<off_t>(sizeof(chunk)) : 0;
+				const ssize_t size = ::pread(m_fd, chunk, static_cast<std::size_t>(end - begin), begin);
+				if (size != end - begin) {
+					return;
+				}
+				const char* last = std::find(std::make_reverse_iterator(chunk + size), std::make_reverse_iterator(chunk), '\n').base();
+				if (last != chunk) {
+					end = begin + (last - chunk); // last is past the '\n'
+					break;
+				}
+				end = begin;
+			}
+			if (end != info.st_size) {
+				[[maybe_unused]] const int truncated = ::ftruncate(m_fd, end);
+			}
+		}
+
+		// whether the file at m_path is no longer the opened one
+		bool replaced() const noexcept {
+			struct stat opened{};
+			struct stat current{};
+			if (::fstat(m_fd, &opened) != 0 || ::stat(m_path.c_str(), &current) != 0) {
+				return true;
+			}
+			return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+		}
+
+		// fills entries with the latest m_max_entries distinct entries, oldest first. Returns the size of the file
+		std::size_t read_latest(std::vector<std::string>& entries) const {
+			struct stat info{};
+			if (::fstat(m_fd, &info) != 0 || info.st_size <= 0) {
+				return 0u;
+			}
+			const auto size = static_cast<std::size_t>(info.st_size);
+			void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+			if (mapping == MAP_FAILED) {
+				return size;
+			}
+
+			const std::string_view text{static_cast<const char*>(mapping), size};
+			std::unordered_set<std::string_view> seen;
+			for (std::size_t end = text.rfind('\n'); end != std::string_view::npos && seen.size() < m_max_entries;) {
+				const std::size_t begin = end == 0u ? std::string_view::npos : text.rfind('\n', end - 1u);
+				const std::string_view line = text.substr(begin + 1u, end - (begin + 1u)); // begin + 1 == 0 for the first line
+				if (!line.empty() && seen.insert(line).second) {
+					entries.emplace_back(line);
+				}
+				end = begin;
+			}
+			::munmap(mapping, size);
+			std::reverse(entries.begin(), entries.end());
+			return size;
+		}
+
+		std::size_t m_max_entries;
+		std::string m_path{};
+		int m_fd{-1};
+	};
+
+	// Persists the history of term (a terminal or a terminal_core) to file
+	template <typename Terminal>
+	void persist_history(Terminal& term, std::shared_ptr<history_file> file) {
+		term.set_history_storage([file] { return file->load(); }, [file](std::string_view line) { file->append(line); });
+	}
+}
+
+#endif //IMTERM_HISTORY_FILE_HPP
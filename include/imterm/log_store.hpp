@@ -0,0 +1,890 @@
+#ifndef IMTERM_LOG_STORE_HPP
+#define IMTERM_LOG_STORE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+#include <unordered_map>
+#endif
+
+#include "utils.hpp"
+#include "search.hpp"
+#include "deferred_text.hpp"
+#ifdef IMTERM_ENABLE_COMPRESSION
+#include "lz.hpp"
+#endif
+
+namespace ImTerm {
+
+	// Stores the messages displayed by terminals
+	// A log store may be shared by several terminals (see terminal::set_log_store): messages are then stored once, while
+	// each terminal keeps its own filter, log level, scrolling and caches.
+	//
+	// Every pushed message is given a sequence number, one more than the previous message's. Stored messages are
+	// those with a sequence number within [first_seq(), end_seq()). Oldest messages are dropped when max_size() messages are
+	// stored, or when stored messages use more than max_bytes() (see bytes()).
+	//
+	// Messages are timestamped (with a monotonic clock) when pushed. Timestamps are thus sorted, and messages logged around a
+	// given time are found by binary search (see seq_at).
+	//
+	// Messages may also be tagged with a channel (typically, the name of the logger they come from, see intern_channel).
+	// The store keeps the sequence numbers of each channel's messages, so that a terminal may display a single channel
+	// without going through every stored message. Channel no_channel holds untagged messages, including the terminal's own.
+	//
+	// Fields (message::field) pushed alongside messages are parsed once and stored by key, in columns sorted by sequence number,
+	// so that queries on a field only go through the messages having it.
+	//
+	// Style runs (message::style_run) pushed alongside messages are likewise kept in a single table sorted by sequence
+	// number, so that messages without colors don't pay for them.
+	//
+	// If IMTERM_ENABLE_TRIGRAM_INDEX is defined, the store also indexes the trigrams (3 consecutive bytes) of each message,
+	// so that substring searches only verify messages containing all of the searched text's trigrams. ASCII letters are
+	// indexed lower case, so that the index also serves case insensitive searches.
+	//
+	// If IMTERM_ENABLE_COMPRESSION is defined, older messages are sealed into blocks of cold_block_size messages, whose text
+	// is compressed (see lz.hpp). Blocks are decompressed on demand by get(), each thread keeping the last few decompressed
+	// blocks. The latest cold_block_size messages or more are always kept uncompressed.
+	//
+	// The text of messages pushed with push_deferred is only formatted when read through get(), each thread keeping the last few
+	// formatted messages. Messages that are never displayed nor searched are thus never formatted.
+	//
+	// Stored messages may be updated in place (see update): views find out which ones through update_count and for_each_update.
+	//
+	// push, push_deferred, update, clear, set_max_size, set_max_bytes and intern_channel may be called from any thread. Other methods
+	// require the caller to hold the lock (see lock() and unlock(), this class meets the Lockable requirements)
+	class log_store {
+	public:
+		using seq_type = std::uint64_t;
+		using channel_type = decltype(message::channel);
+
+		using field_type = std::uint32_t;
+		using clock = std::chrono::steady_clock;
+
+		static constexpr channel_type no_channel = 0u;
+		static constexpr std::size_t max_updates = 4'096u; // number of updates remembered for for_each_update
+
+		struct field_value {
+			seq_type seq; // message holding this value
+			std::string text;
+			double number; // NaN if text is not a number
+		};
+
+		struct styled_run {
+			seq_type seq; // message holding this run
+			message::style_run run;
+		};
+		using style_iterator = std::deque<styled_run>::const_iterator;
+
+		struct stats {
+			std::size_t message_count;
+			std::size_t message_bytes; // text of the stored messages
+			std::size_t channel_count;
+			std::size_t field_count;
+			std::size_t index_bytes; // approximate memory used by the trigram index, 0 if disabled
+			std::size_t compressed_bytes; // compressed text of the sealed messages, 0 if compression is disabled
+		};
+
+#ifdef IMTERM_ENABLE_COMPRESSION
+		static constexpr std::size_t cold_block_size = 512u;
+#endif
+
+		explicit log_store(std::size_t max_size = 5'000) : m_max_size{max_size} {
+			m_flag.clear();
+		}
+
+		log_store(const log_store&) = delete;
+		log_store& operator=(const log_store&) = delete;
+
+		// stores a message, dropping the oldest one if needed. Returns its sequence number
+		// styles must be sorted by position (see ansi::parse)
+		seq_type push(message&& msg, std::vector<message::field>&& fields = {}, const std::vector<message::style_run>& styles = {}) {
+			lock();
+			const seq_type seq = end_seq();
+			push_unlocked(std::move(msg), std::move(fields), styles);
+			unlock();
+			return seq;
+		}
+
+		// stores several messages, taking the lock once. styles[i], if any, holds the style runs of msgs[i]
+		void push(std::vector<message>&& msgs, const std::vector<std::vector<message::style_run>>& styles = {}) {
+			const std::vector<message::style_run> no_style{};
+			lock();
+			for (std::size_t i = 0u; i < msgs.size(); ++i) {
+				push_unlocked(std::move(msgs[i]), {}, i < styles.size() ? styles[i] : no_style);
+			}
+			unlock();
+		}
+
+		// stores a message whose text is formatted on demand, by get(). msg.value is ignored, and escape sequences aren't parsed
+		seq_type push_deferred(message&& msg, const deferred_text& text) {
+			msg.value.clear();
+			lock();
+			const seq_type seq = end_seq();
+			if (m_max_size != 0u) {
+				m_deferred.push_back({seq, next_id(), text});
+				m_bytes += sizeof(deferred_message);
+			}
+			push_unlocked(std::move(msg), {}, {});
+			unlock();
+			return seq;
+		}
+
+		// updates a stored message in place: fn(message&, std::vector<message::style_run>&) may change its text, severity,
+		// progress and style runs. Its channel, fields and timestamp are kept
+		// returns false, without calling fn, if the message was dropped
+		template <typename Function>
+		bool update(seq_type seq, Function&& fn) {
+			lock();
+			const bool stored = seq >= m_first_seq && seq < end_seq();
+			if (stored) {
+				update_unlocked(seq, fn);
+			}
+			unlock();
+			return stored;
+		}
+
+		// drops every message. Sequence numbers keep growing.
+		void clear() {
+			lock();
+			m_first_seq = end_seq();
+			m_hot_first_seq = m_first_seq;
+			m_messages.clear();
+#ifdef IMTERM_ENABLE_COMPRESSION
+			m_blocks.clear();
+			m_blocks_first_seq = m_first_seq;
+#endif
+			m_timestamps.clear();
+			m_bytes = 0u;
+			for (channel& chan : m_channels) {
+				chan.seqs.clear();
+			}
+			for (field_column& column : m_fields) {
+				column.values.clear();
+			}
+			m_styles.clear();
+			m_deferred.clear();
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			m_trigrams.clear();
+#endif
+			unlock();
+		}
+
+		// sets the maximum number of stored messages, dropping the oldest ones if needed
+		void set_max_size(std::size_t max_size) {
+			lock();
+			m_max_size = max_size;
+			evict();
+			unlock();
+		}
+
+		// sets the maximum memory used by stored messages (see bytes()), dropping the oldest ones if needed
+		// the latest message is always kept, even if it is bigger than max_bytes
+		void set_max_bytes(std::size_t max_bytes) {
+			lock();
+			m_max_bytes = max_bytes;
+			evict();
+			unlock();
+		}
+
+		// returns the channel named name, creating it if needed. Channels are never removed.
+		// an empty name refers to no_channel
+		channel_type intern_channel(std::string_view name) {
+			if (name.empty()) {
+				return no_channel;
+			}
+			lock();
+			auto it = std::find_if(std::next(m_channels.cbegin()), m_channels.cend(), [name](const channel& chan) {
+				return chan.name == name;
+			});
+			auto id = static_cast<channel_type>(std::distance(m_channels.cbegin(), it));
+			if (it == m_channels.cend()) {
+				m_channels.push_back({std::string{name}, {}});
+			}
+			unlock();
+			return id;
+		}
+
+		// time at which the given message was pushed
+		// precondition: first_seq() <= seq < end_seq()
+		clock::time_point timestamp(seq_type seq) const noexcept {
+			return m_timestamps[static_cast<std::size_t>(seq - m_first_seq)];
+		}
+
+		// first stored message pushed at time or later, end_seq() if there is none
+		seq_type seq_at(clock::time_point time) const noexcept {
+			return m_first_seq + static_cast<seq_type>(std::lower_bound(m_timestamps.cbegin(), m_timestamps.cend(), time) - m_timestamps.cbegin());
+		}
+
+		// number of channels, including no_channel
+		std::size_t channel_count() const noexcept {
+			return m_channels.size();
+		}
+
+		const std::string& channel_name(channel_type chan) const noexcept {
+			return m_channels[chan].name;
+		}
+
+		// sequence numbers of the stored messages of the given channel, in increasing order
+		const std::deque<seq_type>& channel_seqs(channel_type chan) const noexcept {
+			return m_channels[chan].seqs;
+		}
+
+		// number of distinct field keys pushed so far
+		std::size_t field_count() const noexcept {
+			return m_fields.size();
+		}
+
+		std::optional<field_type> find_field(std::string_view key) const noexcept {
+			auto it = std::find_if(m_fields.cbegin(), m_fields.cend(), [key](const field_column& column) {
+				return column.key == key;
+			});
+			if (it == m_fields.cend()) {
+				return {};
+			}
+			return static_cast<field_type>(std::distance(m_fields.cbegin(), it));
+		}
+
+		// values of the given field held by stored messages, sorted by sequence number
+		const std::deque<field_value>& field_values(field_type fld) const noexcept {
+			return m_fields[fld].values;
+		}
+
+		// value of the given field for the given message, if it has one
+		const field_value* find_field_value(field_type fld, seq_type seq) const noexcept {
+			const std::deque<field_value>& values = m_fields[fld].values;
+			auto it = std::lower_bound(values.cbegin(), values.cend(), seq, [](const field_value& value, seq_type s) {
+				return value.seq < s;
+			});
+			return it != values.cend() && it->seq == seq ? &*it : nullptr;
+		}
+
+		// style runs of the given message, sorted by position
+		std::pair<style_iterator, style_iterator> style_runs(seq_type seq) const noexcept {
+			auto first = std::lower_bound(m_styles.cbegin(), m_styles.cend(), seq, [](const styled_run& styled, seq_type s) {
+				return styled.seq < s;
+			});
+			auto last = first;
+			while (last != m_styles.cend() && last->seq == seq) {
+				++last;
+			}
+			return {first, last};
+		}
+
+		// number of updates made to messages so far
+		std::uint64_t update_count() const noexcept {
+			return m_updates_begin + m_updated.size();
+		}
+
+		// calls fn(seq) for each message updated since the given update count, in order. seq may have been dropped since
+		// returns false, without calling fn, if those updates are no longer all known (the last max_updates are), or if
+		// since comes from another store: every message must then be considered updated
+		template <typename Function>
+		bool for_each_update(std::uint64_t since, Function&& fn) const {
+			if (since < m_updates_begin || since > update_count()) {
+				return false;
+			}
+			std::for_each(m_updated.cbegin() + static_cast<std::ptrdiff_t>(since - m_updates_begin), m_updated.cend(), fn);
+			return true;
+		}
+
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+		// calls fn(seq) for every stored message from seq from onward that may contain needle, in increasing order
+		// returns false, without calling fn, if the index can't narrow the search (needle shorter than 3 bytes)
+		// messages whose text is deferred (see push_deferred) aren't indexed: they are all candidates
+		template <typename Function>
+		bool for_each_candidate(std::string_view needle, seq_type from, Function&& fn) const {
+			if (needle.size() < 3u) {
+				return false;
+			}
+
+			// every candidate contains each trigram of the needle: going through the shortest posting list
+			const posting_list* shortest = nullptr;
+			for (std::uint32_t trigram : trigrams_of(needle)) {
+				auto it = m_trigrams.find(trigram);
+				if (it == m_trigrams.end()) {
+					shortest = nullptr; // no message contains this trigram
+					break;
+				}
+				if (shortest == nullptr || it->second.size() < shortest->size()) {
+					shortest = &it->second;
+				}
+			}
+
+			auto deferred = find_deferred(from);
+			if (shortest != nullptr) {
+				for (std::size_t i = shortest->head; i < shortest->seqs.size(); ++i) {
+					const seq_type seq = to_seq(shortest->seqs[i]);
+					if (seq >= from) {
+						for (; deferred != m_deferred.cend() && deferred->seq < seq; ++deferred) {
+							fn(deferred->seq);
+						}
+						fn(seq);
+					}
+				}
+			}
+			for (; deferred != m_deferred.cend(); ++deferred) {
+				fn(deferred->seq);
+			}
+			return true;
+		}
+#endif
+
+		// requires the lock
+		stats get_stats() const noexcept {
+			stats st{size(), 0u, m_channels.size(), m_fields.size(), 0u, 0u};
+			for (const message& msg : m_messages) {
+				st.message_bytes += msg.value.size();
+			}
+#ifdef IMTERM_ENABLE_COMPRESSION
+			for (std::size_t i = static_cast<std::size_t>(m_first_seq - m_blocks_first_seq); i < m_blocks.size() * cold_block_size; ++i) {
+				st.message_bytes += m_blocks[i / cold_block_size].messages[i % cold_block_size].size;
+			}
+			for (const cold_block& block : m_blocks) {
+				st.compressed_bytes += block.text.size();
+			}
+#endif
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			st.index_bytes = m_trigrams.bucket_count() * sizeof(void*);
+			for (const auto& trigram : m_trigrams) {
+				st.index_bytes += sizeof(trigram) + 2 * sizeof(void*) + trigram.second.seqs.capacity() * sizeof(std::uint32_t);
+			}
+#endif
+			return st;
+		}
+
+		// returns the value of text as a number, NaN if it isn't one
+		static double parse_number(const std::string& text) noexcept {
+			if (text.empty()) {
+				return std::nan("");
+			}
+			char* end{};
+			const double value = std::strtod(text.c_str(), &end);
+			return end == text.c_str() + text.size() ? value : std::nan("");
+		}
+
+		std::size_t max_size() const noexcept {
+			return m_max_size;
+		}
+
+		// no limit by default
+		std::size_t max_bytes() const noexcept {
+			return m_max_bytes;
+		}
+
+		// approximate memory used by stored messages: their text, fields and bookkeeping (indexes excluded)
+		std::size_t bytes() const noexcept {
+			return m_bytes;
+		}
+
+		std::size_t size() const noexcept {
+			return static_cast<std::size_t>(end_seq() - m_first_seq);
+		}
+
+		bool empty() const noexcept {
+			return size() == 0u;
+		}
+
+		// sequence number of the oldest stored message
+		seq_type first_seq() const noexcept {
+			return m_first_seq;
+		}
+
+		// sequence number the next pushed message will get
+		seq_type end_seq() const noexcept {
+			return m_hot_first_seq + m_messages.size();
+		}
+
+		// precondition: first_seq() <= seq < end_seq()
+		// if compression is enabled, or if the message's text is deferred (see push_deferred), the returned reference may be
+		// invalidated by the next calls to get() or peek() from the same thread
+		const message& get(seq_type seq) const {
+			const message& msg = peek(seq);
+			if (msg.value.empty() && !m_deferred.empty() && seq >= m_deferred.front().seq) {
+				return get_deferred(seq, msg);
+			}
+			return msg;
+		}
+
+		// same as get(), but the text of deferred messages is left empty instead of being formatted
+		// cheaper when only the other members of the message are needed
+		const message& peek(seq_type seq) const {
+#ifdef IMTERM_ENABLE_COMPRESSION
+			if (seq < m_hot_first_seq) {
+				return get_cold(seq);
+			}
+#endif
+			return m_messages[static_cast<std::size_t>(seq - m_hot_first_seq)];
+		}
+
+		// waiting threads yield: the lock may be held for a few milliseconds at once (ie: while a view lays out messages)
+		void lock() noexcept {
+			while (m_flag.test_and_set(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+
+		bool try_lock() noexcept {
+			return !m_flag.test_and_set(std::memory_order_acquire);
+		}
+
+		void unlock() noexcept {
+			m_flag.clear(std::memory_order_release);
+		}
+
+	private:
+		struct channel {
+			std::string name;
+			std::deque<seq_type> seqs;
+		};
+
+		struct field_column {
+			std::string key;
+			std::deque<field_value> values;
+		};
+
+		field_type find_or_add_field(std::string_view key) {
+			std::optional<field_type> fld = find_field(key);
+			if (fld) {
+				return *fld;
+			}
+			m_fields.push_back({std::string{key}, {}});
+			return static_cast<field_type>(m_fields.size() - 1);
+		}
+
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+		// sequence numbers of the messages containing a given trigram
+		// only the 32 lower bits are kept: stored messages always span less than 2^32 sequence numbers
+		struct posting_list {
+			std::vector<std::uint32_t> seqs;
+			std::size_t head{0u}; // seqs before head were dropped
+
+			std::size_t size() const noexcept {
+				return seqs.size() - head;
+			}
+		};
+
+		seq_type to_seq(std::uint32_t low_bits) const noexcept {
+			return m_first_seq + static_cast<std::uint32_t>(low_bits - static_cast<std::uint32_t>(m_first_seq));
+		}
+
+		// distinct case folded trigrams of text, in a scratch buffer
+		const std::vector<std::uint32_t>& trigrams_of(std::string_view text) const {
+			auto byte = [&text](std::size_t i) {
+				return static_cast<std::uint32_t>(static_cast<unsigned char>(search::details::to_lower(text[i])));
+			};
+			m_trigram_buffer.clear();
+			for (std::size_t i = 0u; i + 2u < text.size(); ++i) {
+				m_trigram_buffer.push_back(byte(i) << 16u | byte(i + 1) << 8u | byte(i + 2));
+			}
+			std::sort(m_trigram_buffer.begin(), m_trigram_buffer.end());
+			m_trigram_buffer.erase(std::unique(m_trigram_buffer.begin(), m_trigram_buffer.end()), m_trigram_buffer.end());
+			return m_trigram_buffer;
+		}
+#endif
+
+		struct deferred_message {
+			seq_type seq;
+			std::uint64_t id; // unique among every store
+			deferred_text text;
+		};
+
+		struct formatted_message {
+			std::uint64_t id{0u};
+			message msg{};
+		};
+
+		static std::uint64_t next_id() noexcept {
+			static std::atomic<std::uint64_t> last_id{0u};
+			return ++last_id;
+		}
+
+		// first deferred message from seq onward
+		std::deque<deferred_message>::const_iterator find_deferred(seq_type seq) const noexcept {
+			return std::lower_bound(m_deferred.cbegin(), m_deferred.cend(), seq, [](const deferred_message& deferred, seq_type s) {
+				return deferred.seq < s;
+			});
+		}
+
+		const message& get_deferred(seq_type seq, const message& msg) const {
+			auto deferred = find_deferred(seq);
+			if (deferred == m_deferred.cend() || deferred->seq != seq) {
+				return msg;
+			}
+
+			// most recently used first, like decompressed blocks
+			thread_local std::array<formatted_message, 8> cache{};
+			auto it = std::find_if(cache.begin(), cache.end(), [&deferred](const formatted_message& formatted) {
+				return formatted.id == deferred->id;
+			});
+			if (it == cache.end()) {
+				it = std::prev(cache.end());
+				std::string text = std::move(it->msg.value); // keeping its capacity
+				text.clear();
+				deferred->text.format(text);
+				it->msg = msg;
+				it->msg.value = std::move(text);
+				it->id = deferred->id;
+			}
+			std::rotate(cache.begin(), it, std::next(it));
+			return cache.front().msg;
+		}
+
+#ifdef IMTERM_ENABLE_COMPRESSION
+		// message of a sealed block, without its text
+		struct cold_message {
+			std::uint32_t size; // of the message's text
+			std::uint32_t color_beg;
+			std::uint32_t color_end;
+			channel_type channel;
+			std::uint8_t severity;
+			bool is_term_message;
+			float progress;
+		};
+
+		struct cold_block {
+			std::uint64_t id; // unique among every store, changed when the block is modified
+			std::string text; // compressed text of the block's messages, one after the other
+			std::size_t text_size;
+			std::vector<cold_message> messages;
+		};
+
+		struct decompressed_block {
+			std::uint64_t block_id{0u};
+			std::vector<message> messages{};
+		};
+
+		static std::size_t footprint(const cold_block& block) noexcept {
+			return sizeof(cold_block) + block.text.capacity() + block.messages.capacity() * sizeof(cold_message)
+			       + cold_block_size * (sizeof(clock::time_point) + sizeof(seq_type));
+		}
+
+		// compresses the oldest cold_block_size uncompressed messages
+		void seal_block() {
+			if (m_blocks.empty()) {
+				m_blocks_first_seq = m_hot_first_seq;
+			}
+			cold_block& block = m_blocks.emplace_back();
+			encode_block(m_messages.cbegin(), block);
+			for (std::size_t i = 0u; i < cold_block_size; ++i) {
+				m_bytes -= footprint(m_messages[i]);
+			}
+			m_bytes += footprint(block);
+
+			m_messages.erase(m_messages.begin(), m_messages.begin() + static_cast<std::ptrdiff_t>(cold_block_size));
+			m_hot_first_seq += cold_block_size;
+		}
+
+		// fills block with the compressed cold_block_size messages from first
+		template <typename Iterator>
+		void encode_block(Iterator first, cold_block& block) {
+			block.id = next_id();
+			block.messages.clear();
+			block.messages.reserve(cold_block_size);
+			m_seal_buffer.clear();
+			for (std::size_t i = 0u; i < cold_block_size; ++i, ++first) {
+				const message& msg = *first;
+				block.messages.push_back({static_cast<std::uint32_t>(msg.value.size()), static_cast<std::uint32_t>(msg.color_beg),
+				                          static_cast<std::uint32_t>(msg.color_end), msg.channel, static_cast<std::uint8_t>(msg.severity),
+				                          msg.is_term_message, msg.progress});
+				m_seal_buffer += msg.value;
+			}
+			lz::compress(m_seal_buffer, block.text);
+			block.text.shrink_to_fit();
+			block.text_size = m_seal_buffer.size();
+		}
+
+		const message& get_cold(seq_type seq) const {
+			// most recently used first. Decompressed blocks are identified by the id of the block, which changes with its content
+			thread_local std::array<decompressed_block, 8> cache{};
+
+			const cold_block& block = m_blocks[static_cast<std::size_t>((seq - m_blocks_first_seq) / cold_block_size)];
+			auto it = std::find_if(cache.begin(), cache.end(), [&](const decompressed_block& cached) {
+				return cached.block_id == block.id;
+			});
+			if (it == cache.end()) {
+				it = std::prev(cache.end());
+				decompress_block(block, *it);
+				it->block_id = block.id;
+			}
+			std::rotate(cache.begin(), it, std::next(it)); // swapping vectors keeps their elements in place
+			return cache.front().messages[static_cast<std::size_t>((seq - m_blocks_first_seq) % cold_block_size)];
+		}
+
+		static void decompress_block(const cold_block& block, decompressed_block& out) {
+			thread_local std::string text;
+			text.resize(block.text_size);
+			[[maybe_unused]] const bool ok = lz::decompress(block.text, text.data(), text.size());
+			assert(ok);
+
+			out.messages.resize(block.messages.size());
+			std::size_t offset = 0u;
+			for (std::size_t i = 0u; i < block.messages.size(); ++i) {
+				const cold_message& cold = block.messages[i];
+				message& msg = out.messages[i];
+				msg.severity = static_cast<message::severity::severity_t>(cold.severity);
+				msg.value.assign(text, offset, cold.size);
+				msg.color_beg = cold.color_beg;
+				msg.color_end = cold.color_end;
+				msg.is_term_message = cold.is_term_message;
+				msg.channel = cold.channel;
+				msg.progress = cold.progress;
+				offset += cold.size;
+			}
+		}
+#endif
+
+		static std::size_t footprint(const message& msg) noexcept {
+			return sizeof(message) + sizeof(clock::time_point) + sizeof(seq_type) + msg.value.size();
+		}
+
+		static std::size_t field_footprint(const std::string& value) noexcept {
+			return sizeof(field_value) + value.size();
+		}
+
+		void push_unlocked(message&& msg, std::vector<message::field>&& fields, const std::vector<message::style_run>& styles) {
+			if (m_max_size == 0u) {
+				++m_first_seq;
+				++m_hot_first_seq;
+			} else {
+				assert(msg.channel < m_channels.size());
+				m_channels[msg.channel].seqs.push_back(end_seq());
+				m_timestamps.push_back(clock::now()); // taken under the lock: timestamps are sorted like sequence numbers
+				for (message::field& fld : fields) {
+					const double number = parse_number(fld.value);
+					m_bytes += field_footprint(fld.value);
+					m_fields[find_or_add_field(fld.key)].values.push_back({end_seq(), std::move(fld.value), number});
+				}
+				for (const message::style_run& run : styles) {
+					m_styles.push_back({end_seq(), run});
+				}
+				m_bytes += styles.size() * sizeof(styled_run);
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+				for (std::uint32_t trigram : trigrams_of(msg.value)) {
+					m_trigrams[trigram].seqs.push_back(static_cast<std::uint32_t>(end_seq()));
+				}
+#endif
+				m_bytes += footprint(msg);
+				m_messages.emplace_back(std::move(msg));
+				evict();
+#ifdef IMTERM_ENABLE_COMPRESSION
+				if (m_messages.size() >= 2u * cold_block_size) {
+					seal_block();
+				}
+#endif
+			}
+		}
+
+		template <typename Function>
+		void update_unlocked(seq_type seq, Function& fn) {
+			auto first_style = std::lower_bound(m_styles.begin(), m_styles.end(), seq, [](const styled_run& styled, seq_type s) {
+				return styled.seq < s;
+			});
+			auto last_style = first_style;
+			std::vector<message::style_run> styles;
+			for (; last_style != m_styles.end() && last_style->seq == seq; ++last_style) {
+				styles.push_back(last_style->run);
+			}
+			const std::size_t old_style_count = styles.size();
+
+			const bool hot = seq >= m_hot_first_seq;
+#ifdef IMTERM_ENABLE_COMPRESSION
+			// cold messages are updated in a decompressed copy of their block, compressed again afterwards
+			decompressed_block cold{};
+			cold_block* const block = hot ? nullptr : &m_blocks[static_cast<std::size_t>((seq - m_blocks_first_seq) / cold_block_size)];
+			if (!hot) {
+				decompress_block(*block, cold);
+			}
+			message& msg = hot ? m_messages[static_cast<std::size_t>(seq - m_hot_first_seq)]
+			                   : cold.messages[static_cast<std::size_t>((seq - m_blocks_first_seq) % cold_block_size)];
+#else
+			message& msg = m_messages[static_cast<std::size_t>(seq - m_hot_first_seq)];
+#endif
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			const std::vector<std::uint32_t> old_trigrams = trigrams_of(msg.value);
+#endif
+			const channel_type kept_channel = msg.channel;
+			const std::size_t old_footprint = footprint(msg);
+			if (msg.value.empty()) {
+				// a deferred text is formatted for good
+				auto deferred = find_deferred(seq);
+				if (deferred != m_deferred.cend() && deferred->seq == seq) {
+					deferred->text.format(msg.value);
+					m_deferred.erase(deferred);
+					m_bytes -= sizeof(deferred_message);
+				}
+			}
+			fn(msg, styles);
+			msg.channel = channel;
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			reindex(seq, old_trigrams, trigrams_of(msg.value));
+#endif
+
+			if (hot) {
+				m_bytes = m_bytes + footprint(msg) - old_footprint;
+			}
+#ifdef IMTERM_ENABLE_COMPRESSION
+			else {
+				m_bytes -= footprint(*block);
+				encode_block(cold.messages.cbegin(), *block);
+				m_bytes += footprint(*block);
+			}
+#endif
+
+			std::vector<styled_run> runs;
+			runs.reserve(styles.size());
+			for (const message::style_run& run : styles) {
+				runs.push_back({seq, run});
+			}
+			m_styles.insert(m_styles.erase(first_style, last_style), runs.cbegin(), runs.cend());
+			m_bytes = m_bytes + styles.size() * sizeof(styled_run) - old_style_count * sizeof(styled_run);
+
+			m_updated.push_back(seq);
+			if (m_updated.size() > max_updates) {
+				m_updated.pop_front();
+				++m_updates_begin;
+			}
+			evict();
+		}
+
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+		// moves seq from the posting lists of the trigrams its text no longer contains to those of its new trigrams
+		void reindex(seq_type seq, const std::vector<std::uint32_t>& old_trigrams, const std::vector<std::uint32_t>& new_trigrams) {
+			// updated messages are usually recent: searching from the end
+			auto position = [this, seq](posting_list& list) {
+				auto it = list.seqs.end();
+				while (it != list.seqs.begin() + static_cast<std::ptrdiff_t>(list.head) && to_seq(*std::prev(it)) >= seq) {
+					--it;
+				}
+				return it;
+			};
+
+			for (std::uint32_t trigram : old_trigrams) {
+				if (!std::binary_search(new_trigrams.cbegin(), new_trigrams.cend(), trigram)) {
+					auto it = m_trigrams.find(trigram);
+					it->second.seqs.erase(position(it->second));
+					if (it->second.size() == 0u) {
+						m_trigrams.erase(it);
+					}
+				}
+			}
+			for (std::uint32_t trigram : new_trigrams) {
+				if (!std::binary_search(old_trigrams.cbegin(), old_trigrams.cend(), trigram)) {
+					posting_list& list = m_trigrams[trigram];
+					list.seqs.insert(position(list), static_cast<std::uint32_t>(seq));
+				}
+			}
+		}
+#endif
+
+		void evict() {
+			while (size() > m_max_size || (m_bytes > m_max_bytes && size() > 1u)) {
+				pop_front();
+			}
+		}
+
+		void pop_front() {
+			const message& front = peek(m_first_seq);
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			for (std::uint32_t trigram : trigrams_of(front.value)) {
+				auto it = m_trigrams.find(trigram);
+				posting_list& list = it->second;
+				if (++list.head == list.seqs.size()) {
+					m_trigrams.erase(it);
+				} else if (list.head > 32u && list.head * 2u > list.seqs.size()) {
+					list.seqs.erase(list.seqs.begin(), list.seqs.begin() + static_cast<std::ptrdiff_t>(list.head));
+					list.head = 0u;
+				}
+			}
+#endif
+			// the oldest message is also the oldest of its channel, of each of its fields and of the style runs
+			m_channels[front.channel].seqs.pop_front();
+			m_timestamps.pop_front();
+			for (field_column& column : m_fields) {
+				while (!column.values.empty() && column.values.front().seq == m_first_seq) {
+					m_bytes -= field_footprint(column.values.front().text);
+					column.values.pop_front();
+				}
+			}
+			while (!m_styles.empty() && m_styles.front().seq == m_first_seq) {
+				m_bytes -= sizeof(styled_run);
+				m_styles.pop_front();
+			}
+			if (!m_deferred.empty() && m_deferred.front().seq == m_first_seq) {
+				m_bytes -= sizeof(deferred_message);
+				m_deferred.pop_front();
+			}
+#ifdef IMTERM_ENABLE_COMPRESSION
+			if (m_first_seq < m_hot_first_seq) {
+				// the block is dropped with its last message
+				if (++m_first_seq - m_blocks_first_seq == cold_block_size) {
+					m_bytes -= footprint(m_blocks.front());
+					m_blocks.pop_front();
+					m_blocks_first_seq = m_first_seq;
+				}
+				return;
+			}
+#endif
+			m_bytes -= footprint(front);
+			m_messages.pop_front();
+			++m_first_seq;
+			++m_hot_first_seq;
+		}
+
+		std::deque<message> m_messages{}; // uncompressed messages, from m_hot_first_seq onward
+		std::deque<clock::time_point> m_timestamps{}; // m_timestamps[i] is the timestamp of message m_first_seq + i
+		std::vector<channel> m_channels{{std::string{}, {}}}; // m_channels[no_channel] is unnamed
+		std::vector<field_column> m_fields{};
+		std::deque<styled_run> m_styles{};
+		std::deque<deferred_message> m_deferred{}; // messages whose text is formatted on demand, sorted by sequence number
+		std::deque<seq_type> m_updated{}; // updated messages, the oldest update being number m_updates_begin
+		std::uint64_t m_updates_begin{0u};
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+		std::unordered_map<std::uint32_t, posting_list> m_trigrams{};
+		mutable std::vector<std::uint32_t> m_trigram_buffer{};
+#endif
+#ifdef IMTERM_ENABLE_COMPRESSION
+		std::deque<cold_block> m_blocks{}; // compressed messages, from m_blocks_first_seq to m_hot_first_seq
+		seq_type m_blocks_first_seq{0u}; // messages of the first block before m_first_seq were dropped
+		std::string m_seal_buffer{};
+#endif
+		seq_type m_first_seq{0u};
+		seq_type m_hot_first_seq{0u};
+		std::size_t m_max_size;
+		std::size_t m_max_bytes{std::numeric_limits<std::size_t>::max()};
+		std::size_t m_bytes{0u};
+
+		std::atomic_flag m_flag;
+	};
+}
+
+#endif //IMTERM_LOG_STORE_HPP
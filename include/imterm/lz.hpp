@@ -0,0 +1,162 @@
+#ifndef IMTERM_LZ_HPP
+#define IMTERM_LZ_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace ImTerm::lz {
+
+	// Small LZ77 block codec, used to compress old messages (see log_store)
+	// The format follows LZ4's block format: a sequence is a token (literal count in its 4 high bits, match length - 4 in its
+	// 4 low bits, 15 meaning more length bytes follow), the literals, then the match's offset on 2 bytes (little endian).
+	// The last sequence only has literals.
+
+	namespace details {
+		constexpr std::size_t min_match = 4u;
+		constexpr std::size_t max_offset = 65'535u;
+		constexpr unsigned hash_bits = 12u;
+
+		inline std::uint32_t read32(const char* data) noexcept {
+			std::uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		inline std::uint32_t hash(std::uint32_t value) noexcept {
+			return (value * 2'654'435'761u) >> (32u - hash_bits);
+		}
+
+		inline void write_length(std::string& out, std::size_t length) {
+			for (; length >= 255u; length -= 255u) {
+				out += static_cast<char>(255);
+			}
+			out += static_cast<char>(length);
+		}
+
+		inline void write_sequence(std::string& out, std::string_view literals, std::size_t offset, std::size_t match_length) {
+			const std::size_t match_code = match_length == 0u ? 0u : match_length - min_match;
+			out += static_cast<char>((std::min<std::size_t>(literals.size(), 15u) << 4u) | std::min<std::size_t>(match_code, 15u));
+			if (literals.size() >= 15u) {
+				write_length(out, literals.size() - 15u);
+			}
+			out.append(literals);
+			if (match_length != 0u) {
+				out += static_cast<char>(offset & 0xFFu);
+				out += static_cast<char>(offset >> 8u);
+				if (match_code >= 15u) {
+					write_length(out, match_code - 15u);
+				}
+			}
+		}
+
+		// adds the extra length bytes following a token nibble, returns false if in is exhausted
+		inline bool read_length(std::string_view in, std::size_t& pos, std::size_t& length) noexcept {
+			unsigned char byte;
+			do {
+				if (pos == in.size()) {
+					return false;
+				}
+				byte = static_cast<unsigned char>(in[pos++]);
+				length += byte;
+			} while (byte == 255u);
+			return true;
+		}
+	}
+
+	// compresses in into out (replacing its content)
+	inline void compress(std::string_view in, std::string& out) {
+		out.clear();
+		std::array<std::uint32_t, 1u << details::hash_bits> table{}; // position + 1 of the last occurrence of a hash, 0 if none
+
+		std::size_t anchor = 0u; // first byte not yet written
+		std::size_t pos = 0u;
+		while (pos + details::min_match <= in.size()) {
+			const std::uint32_t value = details::read32(in.data() + pos);
+			std::uint32_t& entry = table[details::hash(value)];
+			const std::size_t candidate = entry;
+			entry = static_cast<std::uint32_t>(pos + 1u);
+
+			if (candidate == 0u || pos - (candidate - 1u) > details::max_offset || details::read32(in.data() + candidate - 1u) != value) {
+				++pos;
+				continue;
+			}
+
+			const std::size_t match = candidate - 1u;
+			std::size_t length = details::min_match;
+			while (pos + length < in.size() && in[match + length] == in[pos + length]) {
+				++length;
+			}
+			details::write_sequence(out, in.substr(anchor, pos - anchor), pos - match, length);
+			pos += length;
+			anchor = pos;
+		}
+		details::write_sequence(out, in.substr(anchor), 0u, 0u);
+	}
+
+	// decompresses in into [out, out + out_size)
+	// returns false if in is malformed, or doesn't decompress to exactly out_size bytes
+	inline bool decompress(std::string_view in, char* out, std::size_t out_size) noexcept {
+		std::size_t in_pos = 0u;
+		std::size_t out_pos = 0u;
+		while (in_pos < in.size()) {
+			const auto token = static_cast<unsigned char>(in[in_pos++]);
+
+			std::size_t literals = token >> 4u;
+			if (literals == 15u && !details::read_length(in, in_pos, literals)) {
+				return false;
+			}
+			if (literals > in.size() - in_pos || literals > out_size - out_pos) {
+				return false;
+			}
+			std::memcpy(out + out_pos, in.data() + in_pos, literals);
+			in_pos += literals;
+			out_pos += literals;
+			if (in_pos == in.size()) {
+				break; // last sequence
+			}
+
+			if (in.size() - in_pos < 2u) {
+				return false;
+			}
+			const std::size_t offset = static_cast<unsigned char>(in[in_pos]) | static_cast<std::size_t>(static_cast<unsigned char>(in[in_pos + 1])) << 8u;
+			in_pos += 2u;
+			std::size_t length = token & 0x0Fu;
+			if (length == 15u && !details::read_length(in, in_pos, length)) {
+				return false;
+			}
+			length += details::min_match;
+			if (offset == 0u || offset > out_pos || length > out_size - out_pos) {
+				return false;
+			}
+			for (std::size_t i = 0u; i < length; ++i) { // byte by byte: the match may overlap the copied bytes
+				out[out_pos + i] = out[out_pos - offset + i];
+			}
+			out_pos += length;
+		}
+		return out_pos == out_size;
+	}
+}
+
+#endif //IMTERM_LZ_HPP
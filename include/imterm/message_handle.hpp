@@ -0,0 +1,97 @@
+#ifndef IMTERM_MESSAGE_HANDLE_HPP
+#define IMTERM_MESSAGE_HANDLE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils.hpp"
+#include "log_store.hpp"
+#include "ansi.hpp"
+
+namespace ImTerm {
+
+	// Refers to a logged message, which can be updated in place from any thread, ie: to report progress without logging a new
+	// line at each step (see terminal::add_updatable_message)
+	// Updates of a message that was dropped (or whose log store was destroyed) are ignored and return false
+	class message_handle {
+	public:
+		message_handle() = default;
+
+		message_handle(std::weak_ptr<log_store> store, log_store::seq_type seq) noexcept : m_store{std::move(store)}, m_seq{seq} {}
+
+		// replaces the message's text, which may contain escape sequences (see ansi.hpp)
+		// the colored range is kept, and extended to the end of the text if it reached the end of the previous one
+		bool set_text(std::string text) const {
+			return update([&text](message& msg, std::vector<message::style_run>& styles) {
+				if (msg.color_end == msg.value.size()) {
+					msg.color_end = text.size();
+				}
+				msg.color_beg = std::min(msg.color_beg, text.size());
+				msg.color_end = std::min(msg.color_end, text.size());
+				msg.value = std::move(text);
+				styles.clear();
+				ansi::parse(msg, styles);
+			});
+		}
+
+		bool set_severity(message::severity::severity_t severity) const {
+			return update([severity](message& msg, std::vector<message::style_run>&) {
+				msg.severity = severity;
+			});
+		}
+
+		// progress in [0, 1], drawn behind the message. A negative value hides it
+		bool set_progress(float progress) const {
+			return update([progress](message& msg, std::vector<message::style_run>&) {
+				msg.progress = progress;
+			});
+		}
+
+		// whether the message is still stored
+		bool valid() const {
+			std::shared_ptr<log_store> store = m_store.lock();
+			if (store == nullptr) {
+				return false;
+			}
+			std::lock_guard lock{*store};
+			return m_seq >= store->first_seq() && m_seq < store->end_seq();
+		}
+
+		log_store::seq_type seq() const noexcept {
+			return m_seq;
+		}
+
+	private:
+		template <typename Function>
+		bool update(Function&& fn) const {
+			std::shared_ptr<log_store> store = m_store.lock();
+			return store != nullptr && store->update(m_seq, fn);
+		}
+
+		std::weak_ptr<log_store> m_store{};
+		log_store::seq_type m_seq{0u};
+	};
+}
+
+#endif //IMTERM_MESSAGE_HANDLE_HPP
@@ -0,0 +1,270 @@
+#ifndef IMTERM_QUERY_HPP
+#define IMTERM_QUERY_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils.hpp"
+#include "log_store.hpp"
+#include "search.hpp"
+
+namespace ImTerm {
+
+	// Query typed in the terminal's filter, made of space separated terms, all of which must match:
+	//   - text or "quoted text": the message contains the text
+	//   - level<op>severity: the message's severity compares to the given one (trace, debug, info, warn, err, critical).
+	//     Messages from the terminal itself always match
+	//   - logger:name (or channel:name): the message comes from the given logger (see log_store::intern_channel)
+	//   - key<op>value: the message has a field named key, comparing to value (numerically if both are numbers)
+	// where <op> is one of  : = != < <= > >=  (':' and '=' both meaning equality)
+	//
+	// Text is searched case insensitively (for ASCII letters) if the query was parsed as such.
+	//
+	// A filter without any level, logger or known field term is not a structured query: the terminal then
+	// keeps on searching the whole filter as is (plain text or regex).
+	class log_query {
+	public:
+		enum class comparison {
+			equal,
+			not_equal,
+			less,
+			less_equal,
+			greater,
+			greater_equal
+		};
+
+		struct term {
+			enum class kind {
+				text,
+				level,
+				channel,
+				field
+			};
+
+			kind type;
+			comparison op;
+			std::string token; // term as typed, used as text if the key is not known
+			std::string key;
+			std::string value;
+			double number; // value as a number, NaN if it isn't one
+			message::severity::severity_t severity; // for level terms
+			log_store::channel_type channel; // for resolved channel terms
+			log_store::field_type field; // for resolved field terms
+			bool resolved;
+		};
+
+		static log_query parse(std::string_view filter, bool case_insensitive = false) {
+			log_query query;
+			query.m_case_insensitive = case_insensitive;
+			auto it = filter.begin();
+			while (it != filter.end()) {
+				while (it != filter.end() && *it == ' ') {
+					++it;
+				}
+				if (it == filter.end()) {
+					break;
+				}
+
+				// a token ends on a space that is not within quotes
+				auto token_beg = it;
+				bool in_quotes = false;
+				while (it != filter.end() && (in_quotes || *it != ' ')) {
+					if (*it == '"') {
+						in_quotes = !in_quotes;
+					}
+					++it;
+				}
+				query.m_terms.emplace_back(parse_term({&*token_beg, static_cast<std::size_t>(it - token_beg)}));
+			}
+			return query;
+		}
+
+		// resolves logger and field names against the store. Terms referring to unknown fields are turned into text terms.
+		// requires the store's lock
+		void resolve(const log_store& store) {
+			for (term& t : m_terms) {
+				if (t.type == term::kind::field) {
+					std::optional<log_store::field_type> fld = store.find_field(t.key);
+					t.resolved = fld.has_value();
+					t.field = fld.value_or(0u);
+				} else if (t.type == term::kind::channel) {
+					t.resolved = false;
+					for (log_store::channel_type chan = 1u; chan < store.channel_count(); ++chan) {
+						if (store.channel_name(chan) == t.value) {
+							t.channel = chan;
+							t.resolved = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		// true if the query has any term that is not plain text
+		bool structured() const noexcept {
+			return std::any_of(m_terms.cbegin(), m_terms.cend(), [](const term& t) {
+				return t.type == term::kind::level || t.type == term::kind::channel || (t.type == term::kind::field && t.resolved);
+			});
+		}
+
+		const std::vector<term>& terms() const noexcept {
+			return m_terms;
+		}
+
+		// text to highlight in matching messages (the first text term)
+		std::string_view highlight() const noexcept {
+			for (const term& t : m_terms) {
+				if (t.type == term::kind::text || (t.type == term::kind::field && !t.resolved)) {
+					return text_of(t);
+				}
+			}
+			return {};
+		}
+
+		// term whose index (channel or field values) lists every candidate message, nullptr if all messages are candidates
+		const term* index_term() const noexcept {
+			for (const term& t : m_terms) {
+				if (t.resolved && t.op != comparison::not_equal) {
+					return &t;
+				}
+			}
+			return nullptr;
+		}
+
+		// requires the store's lock
+		bool matches(const log_store& store, log_store::seq_type seq) const {
+			const message& msg = store.peek(seq); // the text is only formatted if a text term is reached
+			return std::all_of(m_terms.cbegin(), m_terms.cend(), [&](const term& t) {
+				switch (t.type) {
+					case term::kind::level:
+						return msg.is_term_message || compare(static_cast<int>(msg.severity), t.op, static_cast<int>(t.severity));
+					case term::kind::channel:
+						if (!t.resolved) {
+							return t.op == comparison::not_equal;
+						}
+						if (t.op == comparison::equal || t.op == comparison::not_equal) {
+							return (msg.channel == t.channel) == (t.op == comparison::equal);
+						}
+						return false;
+					case term::kind::field:
+						if (t.resolved) {
+							const log_store::field_value* value = store.find_field_value(t.field, seq);
+							if (value == nullptr) {
+								return false;
+							}
+							if (!std::isnan(value->number) && !std::isnan(t.number)) {
+								return compare(value->number, t.op, t.number);
+							}
+							return compare(std::string_view{value->text}, t.op, std::string_view{t.value});
+						}
+						[[fallthrough]];
+					case term::kind::text:
+					default:
+						return search::contains(store.get(seq).value, text_of(t), m_case_insensitive);
+				}
+			});
+		}
+
+	private:
+		static std::string_view text_of(const term& t) noexcept {
+			return t.type == term::kind::text ? std::string_view{t.value} : std::string_view{t.token};
+		}
+
+		static std::string unquote(std::string_view str) {
+			if (str.size() >= 2 && str.front() == '"' && str.back() == '"') {
+				str = str.substr(1, str.size() - 2);
+			}
+			return std::string{str};
+		}
+
+		static term parse_term(std::string_view token) {
+			term t{term::kind::text, comparison::equal, std::string{token}, {}, unquote(token), std::nan(""), message::severity::trace, 0u, 0u, false};
+
+			auto is_key_char = [](char c) {
+				return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '-';
+			};
+			auto key_end = std::find_if_not(token.begin(), token.end(), is_key_char);
+			if (key_end == token.begin() || key_end == token.end() || std::isdigit(static_cast<unsigned char>(token.front()))) {
+				return t;
+			}
+
+			std::string_view rest{&*key_end, static_cast<std::size_t>(token.end() - key_end)};
+			constexpr std::pair<std::string_view, comparison> operators[] = {
+					{"!=", comparison::not_equal}, {"<=", comparison::less_equal}, {">=", comparison::greater_equal},
+					{"<", comparison::less}, {">", comparison::greater}, {":", comparison::equal}, {"=", comparison::equal}};
+			auto op = std::find_if(std::begin(operators), std::end(operators), [rest](const auto& o) {
+				return rest.substr(0, o.first.size()) == o.first;
+			});
+			if (op == std::end(operators) || rest.size() == op->first.size()) {
+				return t;
+			}
+
+			std::string_view key{token.data(), static_cast<std::size_t>(key_end - token.begin())};
+			t.op = op->second;
+			t.key = std::string{key};
+			t.value = unquote(rest.substr(op->first.size()));
+			t.number = log_store::parse_number(t.value);
+
+			if (key == "level") {
+				constexpr std::pair<std::string_view, message::severity::severity_t> levels[] = {
+						{"trace", message::severity::trace}, {"debug", message::severity::debug}, {"info", message::severity::info},
+						{"warn", message::severity::warn}, {"warning", message::severity::warn}, {"err", message::severity::err},
+						{"error", message::severity::err}, {"critical", message::severity::critical}};
+				auto level = std::find_if(std::begin(levels), std::end(levels), [&t](const auto& l) {
+					return l.first == t.value;
+				});
+				if (level != std::end(levels)) {
+					t.type = term::kind::level;
+					t.severity = level->second;
+				} else {
+					t.value = t.token; // not a severity: searching for the text itself
+				}
+			} else if (key == "logger" || key == "channel") {
+				t.type = term::kind::channel;
+			} else {
+				t.type = term::kind::field;
+			}
+			return t;
+		}
+
+		template <typename T>
+		static bool compare(const T& lhs, comparison op, const T& rhs) noexcept {
+			switch (op) {
+				case comparison::equal:         return lhs == rhs;
+				case comparison::not_equal:     return lhs != rhs;
+				case comparison::less:          return lhs < rhs;
+				case comparison::less_equal:    return lhs <= rhs;
+				case comparison::greater:       return lhs > rhs;
+				case comparison::greater_equal: return lhs >= rhs;
+				default:                        return false;
+			}
+		}
+
+		std::vector<term> m_terms{};
+		bool m_case_insensitive{false};
+	};
+}
+
+#endif //IMTERM_QUERY_HPP
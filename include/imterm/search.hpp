@@ -0,0 +1,182 @@
+#ifndef IMTERM_SEARCH_HPP
+#define IMTERM_SEARCH_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64) // SSE2 is always available on x86-64
+#define IMTERM_SEARCH_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define IMTERM_SEARCH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace ImTerm::search {
+
+	// Substring search used by the log filter
+	// Candidates are found by comparing, a whole vector at a time, the first and last bytes of the needle against the text
+	// (using AVX2 if the CPU supports it, SSE2 otherwise on x86, one byte at a time on other architectures), then verified
+	// Case insensitive searches only fold ASCII letters
+
+	namespace details {
+		constexpr char to_lower(char c) noexcept {
+			return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		inline bool equal(const char* lhs, const char* rhs, std::size_t size, bool case_insensitive) noexcept {
+			if (!case_insensitive) {
+				return std::memcmp(lhs, rhs, size) == 0;
+			}
+			for (std::size_t i = 0; i < size; ++i) {
+				if (to_lower(lhs[i]) != to_lower(rhs[i])) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline std::size_t find_scalar(std::string_view text, std::string_view needle, std::size_t from, bool case_insensitive) noexcept {
+			const char first = to_lower(needle.front());
+			for (std::size_t i = from; i + needle.size() <= text.size(); ++i) {
+				if ((case_insensitive ? to_lower(text[i]) : text[i]) == (case_insensitive ? first : needle.front())
+				    && equal(text.data() + i + 1, needle.data() + 1, needle.size() - 1, case_insensitive)) {
+					return i;
+				}
+			}
+			return std::string_view::npos;
+		}
+
+#ifdef IMTERM_SEARCH_X86
+		// index of the lowest set bit. mask must not be 0
+		inline std::size_t lowest_bit(unsigned mask) noexcept {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return static_cast<std::size_t>(__builtin_ctz(mask));
+#endif
+		}
+
+		// sets bit 0x20 of upper case ASCII letters
+		inline __m128i to_lower(__m128i block) noexcept {
+			const __m128i shifted = _mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m128i is_upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+			return _mm_or_si128(block, _mm_and_si128(is_upper, _mm_set1_epi8(0x20)));
+		}
+
+		inline std::size_t find_sse2(std::string_view text, std::string_view needle, std::size_t from, bool case_insensitive) noexcept {
+			const std::size_t last = needle.size() - 1;
+			const __m128i first_byte = _mm_set1_epi8(case_insensitive ? to_lower(needle.front()) : needle.front());
+			const __m128i last_byte = _mm_set1_epi8(case_insensitive ? to_lower(needle.back()) : needle.back());
+
+			std::size_t i = from;
+			for (; i + last + 16 <= text.size(); i += 16) {
+				__m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+				__m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i + last));
+				if (case_insensitive) {
+					block_first = to_lower(block_first);
+					block_last = to_lower(block_last);
+				}
+				auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first_byte), _mm_cmpeq_epi8(block_last, last_byte))));
+				while (mask != 0u) {
+					const std::size_t bit = lowest_bit(mask);
+					if (equal(text.data() + i + bit + 1, needle.data() + 1, last, case_insensitive)) {
+						return i + bit;
+					}
+					mask &= mask - 1u;
+				}
+			}
+			return find_scalar(text, needle, i, case_insensitive);
+		}
+
+#ifdef IMTERM_SEARCH_AVX2
+		__attribute__((target("avx2"))) inline __m256i to_lower(__m256i block) noexcept {
+			const __m256i shifted = _mm256_add_epi8(block, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m256i is_upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 26)), shifted);
+			return _mm256_or_si256(block, _mm256_and_si256(is_upper, _mm256_set1_epi8(0x20)));
+		}
+
+		__attribute__((target("avx2"))) inline std::size_t find_avx2(std::string_view text, std::string_view needle, std::size_t from, bool case_insensitive) noexcept {
+			const std::size_t last = needle.size() - 1;
+			const __m256i first_byte = _mm256_set1_epi8(case_insensitive ? to_lower(needle.front()) : needle.front());
+			const __m256i last_byte = _mm256_set1_epi8(case_insensitive ? to_lower(needle.back()) : needle.back());
+
+			std::size_t i = from;
+			for (; i + last + 32 <= text.size(); i += 32) {
+				__m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + i));
+				__m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + i + last));
+				if (case_insensitive) {
+					block_first = to_lower(block_first);
+					block_last = to_lower(block_last);
+				}
+				auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first_byte), _mm256_cmpeq_epi8(block_last, last_byte))));
+				while (mask != 0u) {
+					const std::size_t bit = lowest_bit(mask);
+					if (equal(text.data() + i + bit + 1, needle.data() + 1, last, case_insensitive)) {
+						return i + bit;
+					}
+					mask &= mask - 1u;
+				}
+			}
+			return find_sse2(text, needle, i, case_insensitive);
+		}
+
+		inline bool has_avx2() noexcept {
+			static const bool avx2 = __builtin_cpu_supports("avx2");
+			return avx2;
+		}
+#endif
+#endif
+	}
+
+	// returns the position of the first occurrence of needle in text, starting at from, or std::string_view::npos
+	inline std::size_t find(std::string_view text, std::string_view needle, std::size_t from = 0u, bool case_insensitive = false) noexcept {
+		if (needle.empty()) {
+			return from <= text.size() ? from : std::string_view::npos;
+		}
+		if (from >= text.size() || text.size() - from < needle.size()) {
+			return std::string_view::npos;
+		}
+#ifdef IMTERM_SEARCH_AVX2
+		if (details::has_avx2()) {
+			return details::find_avx2(text, needle, from, case_insensitive);
+		}
+#endif
+#ifdef IMTERM_SEARCH_X86
+		return details::find_sse2(text, needle, from, case_insensitive);
+#else
+		return details::find_scalar(text, needle, from, case_insensitive);
+#endif
+	}
+
+	inline bool contains(std::string_view text, std::string_view needle, bool case_insensitive = false) noexcept {
+		return find(text, needle, 0u, case_insensitive) != std::string_view::npos;
+	}
+}
+
+#endif //IMTERM_SEARCH_HPP
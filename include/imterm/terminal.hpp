@@ -18,16 +18,30 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 #include <utility>
 #include <optional>
 #include <array>
 #include <imgui.h>
+#ifdef IMTERM_ENABLE_REGEX
+#include <regex>
+#endif
+#include <chrono>
 
 #include "utils.hpp"
+#include "terminal_core.hpp"
 #include "misc.hpp"
+#include "log_store.hpp"
+#include "ansi.hpp"
+#include "query.hpp"
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+#include "thread_pool.hpp"
+#endif
+#include "trace.hpp"
 
 #ifdef IMTERM_USE_FMT
 #include "fmt/format.h"
@@ -73,6 +87,116 @@ namespace ImTerm {
 					"TerminalHelper should implement the method 'std::optional<term::message> format(std::string, term::message::type)'. "
 					"See term::terminal_helper_example for reference");
 		};
+
+		// text range [begin, end) of a displayed message. Colors are resolved against the theme when drawing
+		struct color_run {
+			unsigned long begin;
+			unsigned long end;
+			bool colored; // within the message's colored range
+			bool matched; // matches the log filter
+			// colors and style parsed from escape sequences, see message::style_run
+			ImU32 foreground{0u};
+			ImU32 background{0u};
+			std::uint8_t style_flags{0u};
+		};
+
+		// per terminal cache of a displayed message
+		// line breaking is only valid for the font, font size, wrapping width and prefix length it was computed with
+		// color runs are only valid for the highlighted text they were computed with
+		struct message_layout {
+			const ImFont* font{nullptr};
+			float font_size{0.f};
+			float wrap_width{-1.f}; // 0 if autowrap is disabled, negative if the layout was never computed
+			unsigned long prefix_len{0u}; // length of the "[-n] " prefix shown before user inputs
+			float max_row_width{0.f};
+			std::vector<std::pair<unsigned long, unsigned long>> rows{}; // [begin, end) of each displayed row
+
+			unsigned long runs_generation{0u}; // 0 if runs were never computed
+			std::vector<color_run> runs{};
+		};
+
+		// user inputs are echoed as trace messages, and prefixed by their position in the history when displayed
+		inline bool is_user_input(const message& msg) noexcept {
+			return msg.is_term_message && msg.severity == message::severity::trace;
+		}
+
+		// extent of a displayed message, cumulated over the previous ones
+		struct row_extent {
+			double bottom; // from the top of the first measured message (see terminal::m_rows_top)
+			unsigned long traced; // number of user inputs up to this message, included
+		};
+
+		// settings the extent of displayed messages depends on
+		struct rows_key {
+			const ImFont* font{nullptr};
+			float font_size{0.f};
+			float wrap_width{-1.f};
+			float row_height{0.f};
+			unsigned long history_offset{0u}; // numbers the "[-n] " prefixes of user inputs
+
+			bool operator==(const rows_key& other) const noexcept {
+				return font == other.font && font_size == other.font_size && wrap_width == other.wrap_width
+				       && row_height == other.row_height && history_offset == other.history_offset;
+			}
+			bool operator!=(const rows_key& other) const noexcept {
+				return !(*this == other);
+			}
+		};
+
+		// text drawn by the completion OSD
+		struct osd_piece {
+			enum class kind { selected, other, separator };
+
+			std::string_view text;
+			float x; // offset from the OSD's left side
+			kind type;
+			bool truncated{false}; // text is osd_layout::truncated_text
+		};
+
+		// what the completion OSD displays, only computed again when the completion, the OSD's width or the font changes
+		struct osd_layout {
+			unsigned long completion_generation{0u}; // 0 if never computed
+			float max_width{-1.f};
+			const ImFont* font{nullptr};
+			float font_size{0.f};
+			std::vector<osd_piece> pieces{}; // candidates that fit, separators, then the first candidate that didn't, shortened
+			std::string truncated_text{};
+			float width{0.f};
+		};
+
+		// settings deciding which messages are displayed
+		struct view_key {
+			unsigned long filter_generation{0u};
+			int level{0};
+			std::optional<log_store::channel_type> channel{};
+			std::size_t channel_count{0u}; // queries are resolved against known channels and fields
+			std::size_t field_count{0u};
+			bool match_case{true};
+
+			bool operator==(const view_key& other) const noexcept {
+				return filter_generation == other.filter_generation && level == other.level && channel == other.channel
+				       && channel_count == other.channel_count && field_count == other.field_count && match_case == other.match_case;
+			}
+			bool operator!=(const view_key& other) const noexcept {
+				return !(*this == other);
+			}
+		};
+
+		// time spent measuring messages per frame, remaining messages are measured on the next frames
+		constexpr std::chrono::milliseconds measure_budget{4};
+
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+		// number of messages filtered by a single task
+		constexpr std::uint64_t parallel_filter_chunk = 4096u;
+		// time spent filtering messages per frame, remaining messages are filtered on the next frames
+		constexpr std::chrono::milliseconds parallel_filter_budget{8};
+
+		// shared by every terminal
+		inline thread_pool& filter_pool() {
+			static thread_pool pool{};
+			return pool;
+		}
+#endif
 	}
 
 	template<typename TerminalHelper>
@@ -88,7 +212,7 @@ namespace ImTerm {
 		using terminal_helper_is_valid = details::assert_wellformed<TerminalHelper, command_type_cref>;
 
 		inline static const std::vector<config_panels> DEFAULT_ORDER = {config_panels::clearbutton,
-				  config_panels::autoscroll, config_panels::autowrap, config_panels::long_filter, config_panels::loglevel};
+				  config_panels::autoscroll, config_panels::autowrap, config_panels::long_filter, config_panels::match_case, config_panels::loglevel, config_panels::channel};
 
 		// You shall call this constructor you used a non void value_type
 		template <typename T = value_type, typename = std::enable_if_t<!std::is_same_v<T, misc::details::structured_void>>>
@@ -105,7 +229,16 @@ namespace ImTerm {
 
 		// Returns the underlying terminal helper
 		std::shared_ptr<TerminalHelper> get_terminal_helper() {
-			return m_t_helper;
+			return m_core.get_terminal_helper();
+		}
+
+		// Returns the UI independent part of this terminal (logs, history, command dispatch and completion)
+		terminal_core<TerminalHelper>& core() noexcept {
+			return m_core;
+		}
+
+		const terminal_core<TerminalHelper>& core() const noexcept {
+			return m_core;
 		}
 
 		// shows the terminal. Call at each frame (in a more ImGui style, this would be something like ImGui::terminal(....);
@@ -114,8 +247,15 @@ namespace ImTerm {
 		bool show(const std::vector<config_panels>& panels_order = DEFAULT_ORDER) noexcept;
 
 		// returns the command line history
-		const std::vector<std::string>& get_history() const noexcept {
-			return m_command_history;
+		const std::vector<std::string>& get_history() const {
+			return m_core.get_history();
+		}
+
+		// see terminal_core::set_history_storage. The history is loaded right away, as entries typed in this session are numbered
+		// from it
+		void set_history_storage(std::function<std::vector<std::string>()> load, std::function<void(std::string_view)> save) {
+			m_core.set_history_storage(std::move(load), std::move(save));
+			m_last_flush_at_history = m_core.get_history().size();
 		}
 
 		// if invoked, the next call to "show" will return false
@@ -155,8 +295,22 @@ namespace ImTerm {
 		void add_formatted_err(const char* fmt, Args&&... args) {
 			add_text_err(fmt::format(fmt, std::forward<Args>(args)...));
 		}
+
+		// logs a colorless text to the message panel, with the given severity. Unlike terminal messages, it is hidden by the log level
+		// the text is only formatted once displayed, searched or exported: cheap for high volume trace and debug logging
+		// fmt must be FMT_STRING("..."), and arguments must be numbers or enums (see terminal_core::add_deferred_formatted)
+		template <typename Format, typename... Args>
+		void add_deferred_message(message::severity::severity_t severity, const Format& fmt, const Args&... args) {
+			m_core.add_deferred_formatted({severity, {}, 0, 0, false}, fmt, args...);
+		}
 #endif
 
+		// Returns the stream commands write their output to: cheaper than add_text for commands logging many lines
+		// Lines are logged at the beginning of the next frame, and large outputs are shown in a pager (see command_output)
+		command_output& output() noexcept {
+			return m_core.output();
+		}
+
 		// logs a text to the message panel
 		// added as terminal message with info severity
 		void add_text(std::string str, unsigned int color_beg, unsigned int color_end);
@@ -195,11 +349,20 @@ namespace ImTerm {
 		}
 		void add_message(message&& msg);
 
+		// logs a message carrying structured fields, that can be queried from the filter (ie: "latency_ms>50")
+		void add_message(message&& msg, std::vector<message::field> fields);
+
+		// logs a message whose text, severity and progress can be updated afterwards, from any thread, through the returned
+		// handle (ie: progress bars and live counters). Only that message is filtered and laid out again when it changes
+		message_handle add_updatable_message(message&& msg, std::vector<message::field> fields = {}) {
+			return m_core.add_updatable_message(std::move(msg), std::move(fields));
+		}
+
 		// clears the message panel
 		void clear();
 
 		message::severity::severity_t log_level() noexcept {
-			return m_level + m_lowest_log_level_val;
+			return static_cast<message::severity::severity_t>(m_level + m_lowest_log_level_val);
 		}
 
 		void log_level(message::severity::severity_t new_level) noexcept {
@@ -233,6 +396,58 @@ namespace ImTerm {
 			return m_log_level_text;
 		}
 
+		// returns the text used to label the checkbox making the filter case sensitive or not
+		// set it to an empty optional if you don't want the checkbox to be displayed
+		std::optional<std::string>& match_case_text() noexcept {
+			return m_match_case_text;
+		}
+
+		// whether the filter is case sensitive (the default). Case insensitive filters only fold ASCII letters
+		bool match_case() const noexcept {
+			return m_match_case;
+		}
+
+		void set_match_case(bool match_case) noexcept {
+			m_match_case = match_case;
+		}
+
+		// returns the text used to label the checkbox showing or hiding message timestamps
+		// set it to an empty optional if you don't want the checkbox to be displayed
+		std::optional<std::string>& timestamps_text() noexcept {
+			return m_timestamps_text;
+		}
+
+		// returns the text used to label the input restricting messages to the last seconds (0 displaying everything)
+		// set it to an empty optional if you don't want the input to be displayed
+		std::optional<std::string>& time_window_text() noexcept {
+			return m_time_window_text;
+		}
+
+		// returns the hint of the text input used to scroll back to a given time (ie: "-30s", "-5m", "-1h")
+		// set it to an empty optional if you don't want the input to be displayed
+		std::optional<std::string>& goto_time_hint() noexcept {
+			return m_goto_time_hint;
+		}
+
+		// returns the text used to label the drop down list used to select the displayed channel
+		// set it to an empty optional if you don't want the drop down list to be displayed
+		std::optional<std::string>& channel_text() noexcept {
+			return m_channel_text;
+		}
+
+		// returns the text used, in the channel drop down list, for displaying every channel
+		std::string& all_channels_text() noexcept {
+			return m_all_channels_text;
+		}
+
+		// Sets the filter's content, as if typed by the user. The filter is truncated if too long
+		void set_filter(std::string_view filter) noexcept {
+			m_log_text_filter_buffer_usage = static_cast<small_buffer_type::size_type>(std::min(filter.size(), m_log_text_filter_buffer.size() - 1));
+			std::copy(filter.begin(), filter.begin() + m_log_text_filter_buffer_usage, m_log_text_filter_buffer.begin());
+			m_log_text_filter_buffer[m_log_text_filter_buffer_usage] = '\0';
+			++m_filter_generation;
+		}
+
 		// returns the text used to label the text input used to filter out logs
 		// set it to an empty optional if you don't want the filter to be displayed
 		std::optional<std::string>& filter_hint() noexcept {
@@ -256,8 +471,54 @@ namespace ImTerm {
 		}
 
 		// Sets the maximum number of saved messages
+		// If the log store is shared, this applies to every terminal using it
 		void set_max_log_len(std::vector<message>::size_type max_size);
 
+		// Sets the maximum memory used by saved messages (see log_store::bytes()), unlimited by default
+		// Applies alongside set_max_log_len: the oldest messages are dropped when either limit is exceeded
+		void set_max_log_bytes(std::size_t max_bytes);
+
+		// Returns the log store holding this terminal's messages
+		const std::shared_ptr<log_store>& get_log_store() const noexcept {
+			return m_core.get_log_store();
+		}
+
+		// Attaches this terminal to another log store, to share messages between several terminals
+		// Every terminal sharing a store displays the same messages (stored only once), but keeps its own filter, log level and scrolling
+		// Should not be called while messages are being added to this terminal from another thread
+		void set_log_store(std::shared_ptr<log_store> store);
+
+		// Returns the channel being displayed, or an empty optional if every message is displayed
+		std::optional<log_store::channel_type> channel() const noexcept {
+			return m_channel;
+		}
+
+		// Only displays messages of the given channel (and messages having no channel), or every message if chan is empty
+		void set_channel(std::optional<log_store::channel_type> chan) noexcept {
+			m_channel = chan;
+		}
+
+		// Only displays messages logged within the given duration (ie: the last 30 seconds), or every message if window is empty
+		void set_time_window(std::optional<std::chrono::duration<float>> window) noexcept {
+			m_time_window = window;
+		}
+
+		std::optional<std::chrono::duration<float>> time_window() const noexcept {
+			return m_time_window;
+		}
+
+		// Scrolls the message panel to the first message logged at the given time or later, disabling autoscroll
+		void scroll_to_time(log_store::clock::time_point time);
+
+		// Shows, before each message, how long ago it was logged
+		void set_show_timestamps(bool show) noexcept {
+			m_show_timestamps = show;
+		}
+
+		bool show_timestamps() const noexcept {
+			return m_show_timestamps;
+		}
+
 		// Sets the size of the terminal
 		void set_size(unsigned int x, unsigned int y) noexcept {
 			set_width(x);
@@ -326,16 +587,36 @@ namespace ImTerm {
 	private:
 		explicit terminal(value_type& arg_value, const char * window_name_, int base_width_, int base_height_, std::shared_ptr<TerminalHelper> th, terminal_helper_is_valid&&);
 
-		void try_log(std::string_view str, message::type type);
-
 		void compute_text_size() noexcept;
 
 		void display_settings_bar(const std::vector<config_panels>& panels_order) noexcept;
 
 		void display_messages() noexcept;
 
+		// copies the selected messages to the clipboard
+		void copy_selection();
+
+		// returns the layout of the given text for the current font and wrapping width, recomputing it if needed
+		details::message_layout& layout_message(details::message_layout& layout, std::string_view text, unsigned long prefix_len, float wrap_width) const;
+
+		// splits the message in color runs, highlighting parts matching the filter
+		void compute_color_runs(log_store::seq_type seq, const message& msg, unsigned long prefix_len, std::vector<details::color_run>& runs) const;
+
+		// brings m_visible_seqs up to date, filtering new messages only unless the filter, level or channel changed
+		// returns true if messages are left to filter (large scans are split in rounds with IMTERM_ENABLE_PARALLEL_FILTER)
+		bool update_visible_messages();
+
+		void reset_rows() noexcept {
+			m_rows.clear();
+			m_rows_top = 0.;
+			m_rows_width = 0.f;
+		}
+
 		void display_command_line() noexcept;
 
+		// displays the output sent to the pager, if any, in its own window
+		void display_pager() noexcept;
+
 		// displaying command_line itself
 		void show_input_text() noexcept;
 
@@ -343,13 +624,10 @@ namespace ImTerm {
 
 		void show_autocomplete() noexcept;
 
-		void call_command() noexcept;
-
-		void push_message(message&&);
-
-		std::optional<std::string> resolve_history_reference(std::string_view str, bool& modified) const noexcept;
+		// fills m_osd with the candidates fitting in max_width
+		void layout_autocomplete(float max_width, const ImFont* font, float font_size);
 
-		std::pair<bool, std::string> resolve_history_references(std::string_view str, bool& modified) const;
+		void call_command() noexcept;
 
 
 		static int command_line_callback_st(ImGuiInputTextCallbackData * data) noexcept;
@@ -372,32 +650,14 @@ namespace ImTerm {
 			return 0;
 		}
 
-
-		int is_space(std::string_view str) const;
-
-		bool is_digit(char c) const;
-
-		unsigned long get_length(std::string_view str) const;
-
-		// Returns a vector containing each element that were space separated
-		// Returns an empty optional if a '"' char was not matched with a closing '"',
-		//                except if ignore_non_match was set to true
-		std::optional<std::vector<std::string>> split_by_space(std::string_view in, bool ignore_non_match = false) const;
-
-		inline void try_lock()
-		{
-			while (m_flag.test_and_set(std::memory_order_seq_cst)) {}
-		}
-
-		inline void try_unlock()
-		{
-			m_flag.clear(std::memory_order_seq_cst);
+		log_store& store() const noexcept {
+			return *m_core.get_log_store();
 		}
 
 		////////////
 
 		value_type& m_argument_value;
-		mutable std::shared_ptr<TerminalHelper> m_t_helper;
+		terminal_core<TerminalHelper> m_core;
 
 		bool m_should_show_next_frame{true};
 		bool m_close_request{false};
@@ -420,8 +680,12 @@ namespace ImTerm {
 		// configuration
 		bool m_autoscroll{true}; // TODO: accessors
 		bool m_autowrap{true};  // TODO: accessors
-		std::vector<std::string>::size_type m_last_size{0u};
+		bool m_match_case{true};
+		bool m_show_timestamps{false};
+		std::optional<std::chrono::duration<float>> m_time_window{};
+		log_store::seq_type m_last_seq{0u}; // for autoscroll
 		int m_level{message::severity::trace}; // TODO: accessors
+		int m_notified_log_level{-1}; // last log level passed to TerminalHelper::set_terminal_log_level, if it exists
 #ifdef IMTERM_ENABLE_REGEX
 		bool m_regex_search{true}; // TODO: accessors, button
 #endif
@@ -431,6 +695,13 @@ namespace ImTerm {
 		std::optional<std::string> m_log_level_text;
 		std::optional<std::string> m_autowrap_text;
 		std::optional<std::string> m_filter_hint;
+		std::optional<std::string> m_match_case_text;
+		std::optional<std::string> m_timestamps_text;
+		std::optional<std::string> m_time_window_text;
+		std::optional<std::string> m_goto_time_hint;
+		small_buffer_type m_goto_time_buffer{};
+		std::optional<std::string> m_channel_text;
+		std::string m_all_channels_text{"all"};
 		std::string m_level_list_text{};
 		const char* m_longest_log_level{nullptr}; // points to the longest log level, in m_level_list_text
 		const char* m_lowest_log_level{nullptr}; // points to the lowest log level possible, in m_level_list_text
@@ -438,14 +709,42 @@ namespace ImTerm {
 
 		small_buffer_type m_log_text_filter_buffer{};
 		small_buffer_type::size_type m_log_text_filter_buffer_usage{0u};
+		unsigned long m_filter_generation{1u}; // incremented each time the filter changes
+		log_query m_query{}; // parsed filter
+		bool m_structured_filter{false}; // m_query is used, rather than searching the whole filter
+		std::string m_highlight{}; // text (or regex) highlighted in displayed messages
+		unsigned long m_runs_generation{1u}; // incremented each time m_highlight changes
+#ifdef IMTERM_ENABLE_REGEX
+		std::optional<std::regex> m_regex_filter{};
+#endif
 
 
 		// message panel variables
 		unsigned long m_last_flush_at_history{0u}; // for the [-n] indicator on command line
 		bool m_flush_bit{false};
-		std::vector<message> m_logs{};
-		std::vector<message>::size_type m_max_log_len{5'000}; // TODO: command
-		std::vector<message>::size_type m_current_log_oldest_idx{0};
+		std::optional<log_store::channel_type> m_channel{}; // displayed channel, all of them if empty
+		std::deque<details::message_layout> m_layouts{}; // m_layouts[i] is the cached layout of message m_layouts_first_seq + i
+		log_store::seq_type m_layouts_first_seq{0u};
+		std::optional<std::pair<log_store::seq_type, log_store::seq_type>> m_selection{}; // selected messages: anchor, then last clicked
+		std::optional<log_store::seq_type> m_scroll_to{}; // message to scroll to, on next display
+		details::view_key m_visible_key{};
+		std::deque<log_store::seq_type> m_visible_seqs{}; // messages passing the level, channel and filter, in order
+		std::deque<log_store::seq_type> m_visible_inputs{}; // user inputs among m_visible_seqs, numbered by their rank
+		log_store::seq_type m_visible_end{0u}; // messages from this one onward were not filtered yet
+		std::uint64_t m_update_count{0u}; // log_store::update_count() when updates were last taken into account
+		// extents of the first m_rows.size() messages of m_visible_seqs, measured with m_rows_key, so that idle frames only go
+		// through the messages in view. Messages displayed since the last frame are measured, others are only measured again when
+		// they are updated or when the font, width or history changes. Measuring is spread over frames (see details::measure_budget):
+		// the height of the following messages is estimated from the measured ones until then
+		std::deque<details::row_extent> m_rows{};
+		double m_rows_top{0.}; // bottom of the messages dropped from the front of m_rows
+		float m_rows_width{0.f}; // widest measured message
+		details::rows_key m_rows_key{};
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+		log_store::seq_type m_visible_scan_begin{0u}; // for the progress bar
+		std::vector<std::vector<log_store::seq_type>> m_filter_chunks{}; // per task results, merged in order
+#endif
+		std::string m_display_buffer{}; // scratch buffer used when displaying messages
 
 
 		// command line variables
@@ -459,22 +758,18 @@ namespace ImTerm {
 		ImGuiID m_input_text_id{0u};
 
 		// autocompletion
-		std::vector<command_type_cref> m_current_autocomplete{};
-		std::vector<std::string> m_current_autocomplete_strings{};
 		std::string_view m_autocomlete_separator{" | "};
+		details::osd_layout m_osd{};
 		position m_autocomplete_pos{position::down};
 		bool m_command_entered{false};
 
 		// command line: completion using history
 		std::string m_command_line_backup{};
 		std::string_view m_command_line_backup_prefix{};
-		std::vector<std::string> m_command_history{};
-		std::optional<std::vector<std::string>::iterator> m_current_history_selection{};
+		std::optional<std::vector<std::string>::const_iterator> m_current_history_selection{};
 
 		bool m_ignore_next_textinput{false};
 		bool m_has_focus{false};
-
-		std::atomic_flag m_flag;
 	};
 }
 
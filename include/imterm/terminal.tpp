@@ -19,8 +19,14 @@
 #include <imgui_internal.h>
 #include <array>
 #include <cctype>
+#include <cmath>
+#include <cstdlib>
 #include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <iterator>
 #include <algorithm>
@@ -29,61 +35,49 @@
 #endif
 
 #include "misc.hpp"
+#include "search.hpp"
 
 namespace ImTerm
 {
 	namespace details
 	{
 		template <typename T>
-		using is_space_method = decltype(std::declval<T &>().is_space(std::declval<std::string_view>()));
-
-		template <typename TerminalHelper>
-		std::enable_if_t<misc::is_detected_v<is_space_method, TerminalHelper>, int> constexpr is_space(std::shared_ptr<TerminalHelper> &t_h, std::string_view str)
-		{
-			static_assert(std::is_same_v<decltype(t_h->is_space(str)), int>, "TerminalHelper::is_space(std::string_view) should return an int");
-			return t_h->is_space(str);
-		}
-
-		template <typename TerminalHelper>
-		std::enable_if_t<!misc::is_detected_v<is_space_method, TerminalHelper>, int> constexpr is_space(std::shared_ptr<TerminalHelper> &, std::string_view str)
-		{
-			return str[0] == ' ' ? 1 : 0;
-		}
-
-		template <typename T>
-		using get_length_method = decltype(std::declval<T &>().get_length(std::declval<std::string_view>()));
+		using set_terminal_method = decltype(std::declval<T &>().set_terminal(std::declval<terminal<T> &>()));
 
 		template <typename TerminalHelper>
-		std::enable_if_t<misc::is_detected_v<get_length_method, TerminalHelper>, unsigned long> constexpr get_length(std::shared_ptr<TerminalHelper> &t_h, std::string_view str)
+		std::enable_if_t<misc::is_detected_v<set_terminal_method, TerminalHelper>>
+		assign_terminal(TerminalHelper &helper, terminal<TerminalHelper> &terminal)
 		{
-			static_assert(std::is_same_v<decltype(t_h->get_length(str)), int>, "TerminalHelper::get_length(std::string_view) should return an int");
-			return t_h->get_length(str);
+			helper.set_terminal(terminal);
 		}
 
 		template <typename TerminalHelper>
-		std::enable_if_t<!misc::is_detected_v<get_length_method, TerminalHelper>, unsigned long> constexpr get_length(std::shared_ptr<TerminalHelper> &, std::string_view str)
-		{
-			return str.size();
-		}
+		std::enable_if_t<!misc::is_detected_v<set_terminal_method, TerminalHelper>>
+		assign_terminal(TerminalHelper &helper, terminal<TerminalHelper> &terminal) {}
 
 		template <typename T>
-		using set_terminal_method = decltype(std::declval<T &>().set_terminal(std::declval<terminal<T> &>()));
+		using set_terminal_log_level_method = decltype(std::declval<T &>().set_terminal_log_level(std::declval<message::severity::severity_t>()));
 
 		template <typename TerminalHelper>
-		std::enable_if_t<misc::is_detected_v<set_terminal_method, TerminalHelper>>
-		assign_terminal(TerminalHelper &helper, terminal<TerminalHelper> &terminal)
+		std::enable_if_t<misc::is_detected_v<set_terminal_log_level_method, TerminalHelper>>
+		notify_log_level(TerminalHelper &helper, message::severity::severity_t level)
 		{
-			helper.set_terminal(terminal);
+			helper.set_terminal_log_level(level);
 		}
 
 		template <typename TerminalHelper>
-		std::enable_if_t<!misc::is_detected_v<set_terminal_method, TerminalHelper>>
-		assign_terminal(TerminalHelper &helper, terminal<TerminalHelper> &terminal) {}
+		std::enable_if_t<!misc::is_detected_v<set_terminal_log_level_method, TerminalHelper>>
+		notify_log_level(TerminalHelper &, message::severity::severity_t) {}
 
 		// simple as in "non regex"
 		inline std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>>
-		simple_colors_split(std::string_view filter, const message &msg, const std::optional<theme::constexpr_color> &matching_text_color)
+		simple_colors_split(std::string_view filter, const message &msg, const std::optional<theme::constexpr_color> &matching_text_color, bool case_insensitive = false)
 		{
+			auto find = [&](std::string::const_iterator from)
+			{
+				const std::size_t pos = search::find(msg.value, filter, static_cast<std::size_t>(from - msg.value.cbegin()), case_insensitive);
+				return pos == std::string_view::npos ? msg.value.cend() : msg.value.cbegin() + static_cast<std::ptrdiff_t>(pos);
+			};
 
 			std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>> colors;
 			if (filter.empty())
@@ -94,7 +88,7 @@ namespace ImTerm
 				return colors;
 			}
 
-			auto it = std::search(msg.value.cbegin(), msg.value.cend(), filter.begin(), filter.end());
+			auto it = find(msg.value.cbegin());
 			if (it == msg.value.end())
 			{
 				return colors;
@@ -103,15 +97,16 @@ namespace ImTerm
 			auto distance = static_cast<unsigned long>(std::distance(msg.value.cbegin(), it));
 			if (distance > msg.color_beg)
 			{
-				colors.emplace(msg.value.cbegin(), std::pair{msg.color_beg, std::optional<theme::constexpr_color>{}});
+				// later ranges replace the empty ones starting at the same position (ie: if color_beg is 0, or color_beg == color_end)
+				colors[msg.value.cbegin()] = std::pair{msg.color_beg, std::optional<theme::constexpr_color>{}};
 				if (distance > msg.color_end)
 				{
-					colors.emplace(msg.value.cbegin() + msg.color_beg, std::pair{msg.color_end - msg.color_beg, std::optional<theme::constexpr_color>{}});
-					colors.emplace(msg.value.cbegin() + msg.color_end, std::pair{distance - msg.color_end, std::optional<theme::constexpr_color>{}});
+					colors[msg.value.cbegin() + msg.color_beg] = std::pair{msg.color_end - msg.color_beg, std::optional<theme::constexpr_color>{}};
+					colors[msg.value.cbegin() + msg.color_end] = std::pair{distance - msg.color_end, std::optional<theme::constexpr_color>{}};
 				}
 				else
 				{
-					colors.emplace(msg.value.cbegin() + msg.color_beg, std::pair{distance - msg.color_beg, std::optional<theme::constexpr_color>{}});
+					colors[msg.value.cbegin() + msg.color_beg] = std::pair{distance - msg.color_beg, std::optional<theme::constexpr_color>{}};
 				}
 			}
 			else
@@ -126,7 +121,7 @@ namespace ImTerm
 			{
 				colors[it] = std::pair{filter.size(), matching_text_color};
 				last_valid = it + filter.size();
-				it = std::search(last_valid, msg.value.cend(), filter.begin(), filter.end());
+				it = find(last_valid);
 
 				distance = static_cast<unsigned long>(std::distance(last_valid, it));
 				if (last_valid < msg.value.cbegin() + msg.color_beg && last_valid + distance > msg.value.cbegin() + msg.color_beg)
@@ -161,9 +156,97 @@ namespace ImTerm
 			return colors;
 		}
 
+		// writes how long ago a message was logged, ie: "-4.2s", "-3m07s" or "-1h12m"
+		template <std::size_t N>
+		void format_age(log_store::clock::duration age, char (&out)[N]) noexcept
+		{
+			const double seconds = std::chrono::duration<double>(age).count();
+			if (seconds < 60.)
+			{
+				std::snprintf(out, N, "-%.1fs", seconds);
+			}
+			else if (seconds < 3600.)
+			{
+				std::snprintf(out, N, "-%dm%02ds", static_cast<int>(seconds / 60.), static_cast<int>(seconds) % 60);
+			}
+			else
+			{
+				std::snprintf(out, N, "-%dh%02dm", static_cast<int>(seconds / 3600.), static_cast<int>(seconds / 60.) % 60);
+			}
+		}
+
+		// flattens a color map, as returned by simple_colors_split or regex_colors_split, into consecutive runs
+		// runs within [msg.color_beg, msg.color_end) are flagged as colored, runs having their own color as matched
+		inline void to_color_runs(const std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>> &colors,
+		                          const message &msg, std::vector<color_run> &runs)
+		{
+			runs.clear();
+			bool colored = false;
+			for (const auto &color : colors)
+			{
+				const auto offset = static_cast<unsigned long>(std::distance(msg.value.cbegin(), color.first));
+				if (offset == msg.color_beg)
+				{
+					colored = true;
+				}
+				if (offset == msg.color_end)
+				{
+					colored = false;
+				}
+				if (color.second.first != 0)
+				{
+					runs.push_back({offset, offset + color.second.first, colored, color.second.second.has_value()});
+				}
+			}
+		}
+
+		// converts a color parsed from escape sequences (0xAARRGGBB, 0 for none) to ImGui's packing
+		inline ImU32 to_imu32(std::uint32_t color) noexcept
+		{
+			return color == 0u ? 0u : IM_COL32(color >> 16u & 0xFFu, color >> 8u & 0xFFu, color & 0xFFu, color >> 24u);
+		}
+
+		// splits runs at the boundaries of the given style runs (sorted by position), giving their colors and style to the text they cover
+		inline void apply_style_runs(log_store::style_iterator first, log_store::style_iterator last, std::vector<color_run> &runs)
+		{
+			if (first == last)
+			{
+				return;
+			}
+
+			std::vector<color_run> styled;
+			styled.reserve(runs.size() + 2u * static_cast<std::size_t>(std::distance(first, last)));
+			auto style = first;
+			for (const color_run &run : runs)
+			{
+				unsigned long pos = run.begin;
+				while (pos < run.end)
+				{
+					while (style != last && style->run.end <= pos)
+					{
+						++style;
+					}
+					if (style == last || style->run.begin >= run.end)
+					{
+						styled.push_back({pos, run.end, run.colored, run.matched});
+						break;
+					}
+					if (style->run.begin > pos)
+					{
+						styled.push_back({pos, style->run.begin, run.colored, run.matched});
+						pos = style->run.begin;
+					}
+					const unsigned long end = std::min<unsigned long>(style->run.end, run.end);
+					styled.push_back({pos, end, run.colored, run.matched, to_imu32(style->run.foreground), to_imu32(style->run.background), style->run.flags});
+					pos = end;
+				}
+			}
+			runs.swap(styled);
+		}
+
 #ifdef IMTERM_ENABLE_REGEX
 		inline std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>>
-		regex_colors_split(std::string_view filter, const message &msg, const std::optional<theme::constexpr_color> &matching_text_color)
+		regex_colors_split(std::string_view filter, const std::regex &regex, const message &msg, const std::optional<theme::constexpr_color> &matching_text_color)
 		{
 			auto make_pair = [](auto len, std::optional<theme::constexpr_color> color = {})
 			{
@@ -180,7 +263,7 @@ namespace ImTerm
 			}
 
 			std::smatch matches;
-			std::regex_search(msg.value, matches, std::regex(filter.begin(), filter.end()));
+			std::regex_search(msg.value, matches, regex);
 
 			if (matches.empty())
 			{
@@ -251,11 +334,9 @@ namespace ImTerm
 
 	template <typename TerminalHelper>
 	terminal<TerminalHelper>::terminal(value_type &arg_value, const char *window_name_, int base_width_, int base_height_, std::shared_ptr<TerminalHelper> th, terminal_helper_is_valid && /*unused*/)
-		: m_argument_value{arg_value}, m_t_helper{std::move(th)}, m_window_name(window_name_), m_base_width(base_width_), m_base_height(base_height_), m_autoscroll_text{"autoscroll"}, m_clear_text{"clear"}, m_log_level_text{"log level"}, m_autowrap_text{"autowrap"}, m_filter_hint{"filter..."}
+		: m_argument_value{arg_value}, m_core{std::move(th)}, m_window_name(window_name_), m_base_width(base_width_), m_base_height(base_height_), m_autoscroll_text{"autoscroll"}, m_clear_text{"clear"}, m_log_level_text{"log level"}, m_autowrap_text{"autowrap"}, m_filter_hint{"filter..."}, m_match_case_text{"match case"}, m_timestamps_text{"timestamps"}, m_time_window_text{"last (s)"}, m_goto_time_hint{"go to (-30s)"}, m_channel_text{"channel"}
 	{
-		m_flag.clear();
-		assert(m_t_helper != nullptr);
-		details::assign_terminal(*m_t_helper, *this);
+		details::assign_terminal(*m_core.get_terminal_helper(), *this);
 
 		std::fill(m_command_buffer.begin(), m_command_buffer.end(), '\0');
 		std::fill(m_log_text_filter_buffer.begin(), m_log_text_filter_buffer.end(), '\0');
@@ -265,9 +346,20 @@ namespace ImTerm
 	template <typename TerminalHelper>
 	bool terminal<TerminalHelper>::show(const std::vector<config_panels> &panels_order) noexcept
 	{
+		IMTERM_TRACE_SCOPE("terminal::show");
+
+		m_core.sync_commands();
+		m_core.flush_output();
+
+		if (log_level() != m_notified_log_level)
+		{
+			m_notified_log_level = log_level();
+			details::notify_log_level(*m_core.get_terminal_helper(), log_level());
+		}
+
 		if (m_flush_bit)
 		{
-			m_last_flush_at_history = m_command_history.size();
+			m_last_flush_at_history = m_core.get_history().size();
 			m_flush_bit = false;
 		}
 
@@ -348,10 +440,24 @@ namespace ImTerm
 		m_current_size = ImGui::GetWindowSize();
 
 		display_settings_bar(panels_order);
-		try_lock();
+		store().lock();
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+		// large scans are filtered one round of chunks at a time, for a limited time per frame: the lock is released between
+		// rounds, so that logging threads aren't kept waiting
+		const auto filter_start = std::chrono::steady_clock::now();
+		while (update_visible_messages() && std::chrono::steady_clock::now() - filter_start < details::parallel_filter_budget)
+		{
+			store().unlock();
+			std::this_thread::yield();
+			store().lock();
+		}
+#else
+		update_visible_messages();
+#endif
 		display_messages();
-		try_unlock();
+		store().unlock();
 		display_command_line();
+		display_pager();
 
 		ImGui::PopStyleColor(pop_count);
 
@@ -402,45 +508,33 @@ namespace ImTerm
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::add_text(std::string str, unsigned int color_beg, unsigned int color_end)
 	{
-		message msg;
-		msg.is_term_message = true;
-		msg.severity = message::severity::info;
-		msg.color_beg = color_beg;
-		msg.color_end = color_end;
-		msg.value = std::move(str);
-		push_message(std::move(msg));
+		m_core.add_text(std::move(str), color_beg, color_end);
 	}
 
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::add_text_err(std::string str, unsigned int color_beg, unsigned int color_end)
 	{
-		message msg;
-		msg.is_term_message = true;
-		msg.severity = message::severity::warn;
-		msg.color_beg = color_beg;
-		msg.color_end = color_end;
-		msg.value = std::move(str);
-		push_message(std::move(msg));
+		m_core.add_text_err(std::move(str), color_beg, color_end);
 	}
 
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::add_message(message &&msg)
 	{
-		if (msg.is_term_message && msg.severity != message::severity::warn)
-		{
-			msg.severity = message::severity::info;
-		}
-		push_message(std::move(msg));
+		m_core.add_message(std::move(msg));
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::add_message(message &&msg, std::vector<message::field> fields)
+	{
+		m_core.add_message(std::move(msg), std::move(fields));
 	}
 
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::clear()
 	{
 		m_flush_bit = true;
-		try_lock();
-		m_logs.clear();
-		m_current_log_oldest_idx = 0u;
-		try_unlock();
+		m_core.clear();
+		m_selection.reset();
 	}
 
 	template <typename TerminalHelper>
@@ -482,7 +576,7 @@ namespace ImTerm
 		for (int i = level; i < message::severity::critical + 2; ++i)
 		{
 			auto length = std::strlen(current_str);
-			auto regular_len = get_length({current_str, length});
+			auto regular_len = m_core.get_length({current_str, length});
 			if (regular_len > longest_len)
 			{
 				longest_len = regular_len;
@@ -495,46 +589,34 @@ namespace ImTerm
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::set_max_log_len(std::vector<message>::size_type max_size)
 	{
-		try_lock();
-		std::vector<message> new_msg_vect;
-		new_msg_vect.reserve(max_size);
-		for (auto i = 0u; i < std::min(max_size, m_logs.size() - m_current_log_oldest_idx); ++i)
-		{
-			new_msg_vect.emplace_back(std::move(m_logs[i + m_current_log_oldest_idx]));
-		}
-		for (auto i = 0u; i < std::min(max_size - new_msg_vect.size(), m_logs.size() - new_msg_vect.size()); ++i)
-		{
-			new_msg_vect.emplace_back(std::move(m_logs[i]));
-		}
-		m_logs = std::move(new_msg_vect);
-		m_current_log_oldest_idx = 0u;
-		m_max_log_len = max_size;
-		try_unlock();
+		store().set_max_size(max_size);
 	}
 
 	template <typename TerminalHelper>
-	void terminal<TerminalHelper>::try_log(std::string_view str, message::type type)
+	void terminal<TerminalHelper>::set_max_log_bytes(std::size_t max_bytes)
 	{
-		message::severity::severity_t severity;
-		switch (type)
-		{
-		case message::type::user_input:
-			severity = message::severity::trace;
-			break;
-		case message::type::error:
-			severity = message::severity::err;
-			break;
-		case message::type::cmd_history_completion:
-			severity = message::severity::debug;
-			break;
-		}
-		std::optional<message> msg = m_t_helper->format({str.data(), str.size()}, type);
-		if (msg)
-		{
-			msg->is_term_message = true;
-			msg->severity = severity;
-			push_message(std::move(*msg));
-		}
+		store().set_max_bytes(max_bytes);
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::scroll_to_time(log_store::clock::time_point time)
+	{
+		std::lock_guard lock{store()};
+		m_scroll_to = store().seq_at(time);
+		m_autoscroll = false;
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::set_log_store(std::shared_ptr<log_store> store)
+	{
+		m_core.set_log_store(std::move(store));
+		m_layouts.clear();
+		m_layouts_first_seq = 0u;
+		m_selection.reset();
+		m_channel.reset(); // channels are specific to each store
+		m_visible_key = {};
+		m_update_count = 0u;
+		m_last_seq = 0u;
 	}
 
 	template <typename TerminalHelper>
@@ -544,7 +626,7 @@ namespace ImTerm
 		{
 			return;
 		}
-		if (!m_autoscroll_text && !m_autowrap_text && !m_clear_text && !m_filter_hint && !m_log_level_text)
+		if (!m_autoscroll_text && !m_autowrap_text && !m_clear_text && !m_filter_hint && !m_log_level_text && !m_channel_text && !m_match_case_text && !m_timestamps_text && !m_time_window_text && !m_goto_time_hint)
 		{
 			return;
 		}
@@ -553,6 +635,16 @@ namespace ImTerm
 
 		const float autowrap_size = !m_autowrap_text ? 0.f : ImGui::CalcTextSize(m_autowrap_text->data()).x + ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x;
 
+		const float match_case_size = !m_match_case_text ? 0.f : ImGui::CalcTextSize(m_match_case_text->data()).x + ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x;
+
+		const float timestamps_size = !m_timestamps_text ? 0.f : ImGui::CalcTextSize(m_timestamps_text->data()).x + ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x;
+
+		const float time_window_input_size = ImGui::CalcTextSize("00000").x + ImGui::GetStyle().FramePadding.x * 2.f;
+
+		const float time_window_size = !m_time_window_text ? 0.f : ImGui::CalcTextSize(m_time_window_text->data()).x + ImGui::GetStyle().ItemSpacing.x + time_window_input_size;
+
+		const float goto_time_size = !m_goto_time_hint ? 0.f : ImGui::CalcTextSize(m_goto_time_hint->data()).x + ImGui::GetStyle().FramePadding.x * 2.f;
+
 		const float clearbutton_size = !m_clear_text ? 0.f : ImGui::CalcTextSize(m_clear_text->data()).x + ImGui::GetStyle().FramePadding.x * 2.f;
 
 		const float filter_size = !m_filter_hint ? 0.f : ImGui::CalcTextSize(m_filter_hint->data()).x + ImGui::GetStyle().FramePadding.x * 2.f;
@@ -561,6 +653,24 @@ namespace ImTerm
 
 		const float loglevel_global_size = !m_log_level_text ? 0.f : ImGui::CalcTextSize(m_log_level_text->data()).x + ImGui::GetStyle().ItemSpacing.x + loglevel_selector_size;
 
+		// channels may be created by loggers from other threads
+		float channel_selector_size = 0.f;
+		if (m_channel_text)
+		{
+			std::lock_guard lock{store()};
+			if (store().channel_count() > 1u)
+			{
+				float longest_channel = ImGui::CalcTextSize(m_all_channels_text.c_str()).x;
+				for (log_store::channel_type chan = 1u; chan < store().channel_count(); ++chan)
+				{
+					longest_channel = std::max(longest_channel, ImGui::CalcTextSize(store().channel_name(chan).c_str()).x);
+				}
+				channel_selector_size = longest_channel + ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x * 2.f;
+			}
+		}
+
+		const float channel_global_size = channel_selector_size == 0.f ? 0.f : ImGui::CalcTextSize(m_channel_text->data()).x + ImGui::GetStyle().ItemSpacing.x + channel_selector_size;
+
 		unsigned space_consumer_count = 0u;
 		float required_space = ImGui::GetStyle().ItemSpacing.x * (panels_order.size() - 1);
 		for (config_panels panel : panels_order)
@@ -573,6 +683,18 @@ namespace ImTerm
 			case config_panels::autowrap:
 				required_space += autowrap_size;
 				break;
+			case config_panels::match_case:
+				required_space += match_case_size;
+				break;
+			case config_panels::timestamps:
+				required_space += timestamps_size;
+				break;
+			case config_panels::time_window:
+				required_space += time_window_size;
+				break;
+			case config_panels::goto_time:
+				required_space += goto_time_size;
+				break;
 			case config_panels::clearbutton:
 				required_space += clearbutton_size;
 				break;
@@ -582,6 +704,9 @@ namespace ImTerm
 			case config_panels::loglevel:
 				required_space += loglevel_global_size;
 				break;
+			case config_panels::channel:
+				required_space += channel_global_size;
+				break;
 			case config_panels::long_filter:
 				[[fallthrough]];
 			case config_panels::blank:
@@ -616,6 +741,7 @@ namespace ImTerm
 				if (ImGui::InputTextWithHint("##terminal:settings:text_filter", m_filter_hint->data(), m_log_text_filter_buffer.data(), m_log_text_filter_buffer.size()))
 				{
 					m_log_text_filter_buffer_usage = misc::strnlen(m_log_text_filter_buffer.data(), m_log_text_filter_buffer.size());
+					++m_filter_generation;
 				}
 				ImGui::PopItemWidth();
 
@@ -652,6 +778,67 @@ namespace ImTerm
 					ImGui::Dummy(ImVec2(autowrap_size, 1.f));
 				}
 				break;
+			case config_panels::match_case:
+				if (m_match_case_text)
+				{
+					ImGui::Checkbox(m_match_case_text->data(), &m_match_case);
+				}
+				else
+				{
+					ImGui::Dummy(ImVec2(match_case_size, 1.f));
+				}
+				break;
+			case config_panels::timestamps:
+				if (m_timestamps_text)
+				{
+					ImGui::Checkbox(m_timestamps_text->data(), &m_show_timestamps);
+				}
+				else
+				{
+					ImGui::Dummy(ImVec2(timestamps_size, 1.f));
+				}
+				break;
+			case config_panels::time_window:
+				if (m_time_window_text)
+				{
+					ImGui::TextUnformatted(m_time_window_text->data(), m_time_window_text->data() + m_time_window_text->size());
+
+					ImGui::SameLine();
+					ImGui::PushItemWidth(time_window_input_size);
+					float seconds = m_time_window ? m_time_window->count() : 0.f;
+					if (ImGui::InputFloat("##terminal:settings:time_window", &seconds, 0.f, 0.f, "%.0f"))
+					{
+						set_time_window(seconds > 0.f ? std::optional{std::chrono::duration<float>{seconds}} : std::nullopt);
+					}
+					ImGui::PopItemWidth();
+				}
+				else
+				{
+					ImGui::Dummy(ImVec2(time_window_size, 1.f));
+				}
+				break;
+			case config_panels::goto_time:
+				if (m_goto_time_hint)
+				{
+					ImGui::PushItemWidth(goto_time_size);
+					if (ImGui::InputTextWithHint("##terminal:settings:goto_time", m_goto_time_hint->data(), m_goto_time_buffer.data(), m_goto_time_buffer.size(), ImGuiInputTextFlags_EnterReturnsTrue))
+					{
+						// "-30s", "30s", "5m", "1h" or "30" (seconds)
+						char *unit{};
+						const double amount = std::abs(std::strtod(m_goto_time_buffer.data(), &unit));
+						const double factor = *unit == 'm' ? 60. : *unit == 'h' ? 3600. : 1.;
+						if (unit != m_goto_time_buffer.data())
+						{
+							scroll_to_time(log_store::clock::now() - std::chrono::duration_cast<log_store::clock::duration>(std::chrono::duration<double>{amount * factor}));
+						}
+					}
+					ImGui::PopItemWidth();
+				}
+				else
+				{
+					ImGui::Dummy(ImVec2(goto_time_size, 1.f));
+				}
+				break;
 			case config_panels::blank:
 				ImGui::Dummy(ImVec2(consumer_width, 1.f));
 				break;
@@ -689,6 +876,33 @@ namespace ImTerm
 					ImGui::Dummy(ImVec2(loglevel_global_size, 1.f));
 				}
 				break;
+			case config_panels::channel:
+				if (channel_selector_size != 0.f)
+				{
+					ImGui::TextUnformatted(m_channel_text->data(), m_channel_text->data() + m_channel_text->size());
+
+					ImGui::SameLine();
+					ImGui::PushItemWidth(channel_selector_size);
+					std::lock_guard lock{store()};
+					const char *preview = m_channel && *m_channel < store().channel_count() ? store().channel_name(*m_channel).c_str() : m_all_channels_text.c_str();
+					if (ImGui::BeginCombo("##terminal:channel_selector:combo", preview))
+					{
+						if (ImGui::Selectable(m_all_channels_text.c_str(), !m_channel))
+						{
+							m_channel.reset();
+						}
+						for (log_store::channel_type chan = 1u; chan < store().channel_count(); ++chan)
+						{
+							if (ImGui::Selectable(store().channel_name(chan).c_str(), m_channel == chan))
+							{
+								m_channel = chan;
+							}
+						}
+						ImGui::EndCombo();
+					}
+					ImGui::PopItemWidth();
+				}
+				break;
 			default:
 				break;
 			}
@@ -701,136 +915,294 @@ namespace ImTerm
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::display_messages() noexcept
 	{
-
+		IMTERM_TRACE_SCOPE("terminal::display_messages (filter)");
 		ImVec2 avail_space = ImGui::GetContentRegionAvail();
 		float commandline_height = ImGui::CalcTextSize("a").y + ImGui::GetStyle().FramePadding.y * 4.f;
 		if (avail_space.y > commandline_height)
 		{
 
 			int style_push_count = try_push_style(ImGuiCol_ChildBg, m_colors.message_panel);
+			bool rows_measured{false}; // messages measured this frame may have moved the end
 			if (ImGui::BeginChild("terminal:logs_window", ImVec2(avail_space.x, avail_space.y - commandline_height), false,
 								  ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_NoTitleBar))
 			{
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+				if (m_visible_end < store().end_seq())
+				{
+					const log_store::seq_type scan_begin = std::max(m_visible_scan_begin, store().first_seq());
+					ImGui::ProgressBar(static_cast<float>(m_visible_end - scan_begin) / static_cast<float>(store().end_seq() - scan_begin), ImVec2(-1.f, 0.f));
+				}
+#endif
 
-				unsigned traced_count = 0;
-				void (*text_formatted)(const char *, ...);
-				if (m_autowrap)
+				// messages are measured once (see m_rows): those out of view are replaced by dummy items without going through them
+				const float time_gutter = m_show_timestamps ? ImGui::CalcTextSize("-00h00m ").x : 0.f;
+				const float wrap_width = m_autowrap ? std::max(ImGui::GetContentRegionAvail().x - time_gutter, 1.f) : 0.f;
+				const float row_height = ImGui::GetTextLineHeightWithSpacing();
+				const float item_spacing = ImGui::GetStyle().ItemSpacing.y;
+				const float visible_top = ImGui::GetScrollY();
+				const float visible_bottom = visible_top + ImGui::GetWindowHeight();
+
+				const log_store::seq_type first_seq = store().first_seq();
+				const log_store::seq_type end_seq = store().end_seq();
+
+				// dropping the cache of messages that are no longer stored
+				if (m_layouts_first_seq + m_layouts.size() <= first_seq || m_layouts_first_seq > first_seq)
 				{
-					text_formatted = ImGui::TextWrapped;
+					m_layouts.clear();
+					m_layouts_first_seq = first_seq;
 				}
-				else
+				m_layouts.erase(m_layouts.begin(), m_layouts.begin() + static_cast<long>(first_seq - m_layouts_first_seq));
+				m_layouts_first_seq = first_seq;
+				m_layouts.resize(static_cast<std::size_t>(end_seq - first_seq));
+
+				if (m_selection && std::min(m_selection->first, m_selection->second) < first_seq)
 				{
-					text_formatted = ImGui::Text;
+					m_selection.reset(); // selected messages were dropped
 				}
 
-				auto print_single_message = [this, &traced_count, &text_formatted](const message &msg)
+				// only displaying messages from the time window, found by binary search
+				auto first_displayed = m_visible_seqs.cbegin();
+				if (m_time_window)
+				{
+					const log_store::seq_type window_begin = store().seq_at(log_store::clock::now() - std::chrono::duration_cast<log_store::clock::duration>(*m_time_window));
+					first_displayed = std::lower_bound(m_visible_seqs.cbegin(), m_visible_seqs.cend(), window_begin);
+				}
+
+				ImFont *font = ImGui::GetFont();
+				const float font_size = ImGui::GetFontSize();
+				const ImU32 text_color = ImGui::GetColorU32(ImGuiCol_Text);
+				const ImU32 matching_text_color = m_colors.matching_text ? ImGui::GetColorU32(m_colors.matching_text->imv4()) : text_color;
+				const ImU32 selection_color = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+				const ImU32 progress_color = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+				const ImU32 background_color = ImGui::GetColorU32(ImGuiCol_WindowBg);
+
+				// user inputs are prefixed by their position in the history
+				const unsigned long history_offset = m_last_flush_at_history - m_core.get_history().size();
+				auto displayed_text = [&](const message &msg, unsigned long traced, unsigned long &prefix_len) -> std::string_view
 				{
-					if (msg.severity < (m_level + m_lowest_log_level_val) && !msg.is_term_message)
+					prefix_len = 0u;
+					if (!details::is_user_input(msg))
 					{
-						return;
+						return msg.value;
 					}
+					char prefix[32];
+					int len = std::snprintf(prefix, sizeof(prefix), "[%d] ", static_cast<int>(traced + history_offset));
+					prefix_len = static_cast<unsigned long>(std::max(len, 0));
+					m_display_buffer.assign(msg.value, 0u, msg.color_beg);
+					m_display_buffer.append(prefix, prefix_len);
+					m_display_buffer.append(msg.value, msg.color_beg, std::string::npos);
+					return m_display_buffer;
+				};
 
-					if (msg.value.empty())
+				// measuring the messages displayed since the last frame, or all of them if their extent may have changed, within the
+				// frame's budget: the height of the others is estimated from the measured ones, until a next frame measures them
+				const details::rows_key rows_key{font, font_size, wrap_width, row_height, history_offset};
+				if (rows_key != m_rows_key)
+				{
+					reset_rows();
+					m_rows_key = rows_key;
+				}
+				const auto measure_start = std::chrono::steady_clock::now();
+				while (m_rows.size() < m_visible_seqs.size() && std::chrono::steady_clock::now() - measure_start < details::measure_budget)
+				{
+					const log_store::seq_type seq = m_visible_seqs[m_rows.size()];
+					const message &msg = store().get(seq);
+					const double top = m_rows.empty() ? m_rows_top : m_rows.back().bottom;
+					const unsigned long traced = m_rows.empty() ? 0u : m_rows.back().traced;
+					unsigned long prefix_len{};
+					const std::string_view text = displayed_text(msg, traced, prefix_len);
+					const details::message_layout &layout = layout_message(m_layouts[static_cast<std::size_t>(seq - first_seq)], text, prefix_len, wrap_width);
+					m_rows.push_back({top + static_cast<double>(layout.rows.size()) * row_height, traced + (details::is_user_input(msg) ? 1u : 0u)});
+					m_rows_width = std::max(m_rows_width, layout.max_row_width);
+					rows_measured = true;
+				}
+
+				const std::size_t measured = m_rows.size();
+				const std::size_t first_index = static_cast<std::size_t>(first_displayed - m_visible_seqs.cbegin());
+				const double estimated_height = measured == 0u ? row_height : std::max((m_rows.back().bottom - m_rows_top) / static_cast<double>(measured), static_cast<double>(row_height));
+				auto top_of = [&](std::size_t index)
+				{
+					const std::size_t from = std::min(index, measured);
+					const double top = from == 0u ? m_rows_top : m_rows[from - 1u].bottom;
+					return top + static_cast<double>(index - from) * estimated_height;
+				};
+				// first message from first_index whose bottom is at y or below
+				auto index_at = [&](double y)
+				{
+					if (first_index < measured && y <= top_of(measured))
 					{
-						ImGui::NewLine();
-						return;
+						return static_cast<std::size_t>(std::lower_bound(m_rows.cbegin() + static_cast<long>(first_index), m_rows.cend(), y,
+																		 [](const details::row_extent &row, double bottom)
+																		 { return row.bottom < bottom; })
+														- m_rows.cbegin());
 					}
+					const std::size_t from = std::max(first_index, measured);
+					const double skipped = std::max((y - top_of(from)) / estimated_height, 0.);
+					return std::min(from + static_cast<std::size_t>(skipped), m_visible_seqs.size());
+				};
+				const double origin_y = static_cast<double>(ImGui::GetCursorPosY()) - top_of(first_index); // panel position of extent 0
 
-					std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>> colors;
-#ifdef IMTERM_ENABLE_REGEX
-					if (m_regex_search)
+				if (m_scroll_to)
+				{
+					auto it = std::lower_bound(first_displayed, m_visible_seqs.cend(), *m_scroll_to);
+					// scrolling to the end if every displayed message is older than the requested time
+					ImGui::SetScrollY(it == m_visible_seqs.cend() ? ImGui::GetScrollMaxY()
+																 : static_cast<float>(origin_y + top_of(static_cast<std::size_t>(it - m_visible_seqs.cbegin()))));
+					m_scroll_to.reset();
+				}
+
+				auto print_single_message = [&](std::size_t index)
+				{
+					const log_store::seq_type seq = m_visible_seqs[index];
+					// user inputs before this one, whether or not they were measured yet
+					const auto traced = static_cast<unsigned long>(std::lower_bound(m_visible_inputs.cbegin(), m_visible_inputs.cend(), seq) - m_visible_inputs.cbegin());
+					const message &msg = store().get(seq);
+					unsigned long prefix_len{};
+					const std::string_view text = displayed_text(msg, traced, prefix_len);
+					details::message_layout &layout = layout_message(m_layouts[static_cast<std::size_t>(seq - first_seq)], text, prefix_len, wrap_width);
+					const float height = static_cast<float>(layout.rows.size()) * row_height;
+
+					// the whole message is a single item: glyphs are written straight to the draw list
+					const ImVec2 origin = ImGui::GetCursorScreenPos();
+					const ImVec2 item_size{std::max(time_gutter + layout.max_row_width, ImGui::GetContentRegionAvail().x), height - item_spacing};
+					ImGui::Dummy(item_size);
+
+					if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
 					{
-						try
+						if (m_selection && ImGui::GetIO().KeyShift)
 						{
-							std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
-							colors = details::regex_colors_split(filter, msg, m_colors.matching_text);
+							m_selection->second = seq;
 						}
-						catch (const std::regex_error &)
+						else
 						{
-							return; // malformed regex is treated as no match
+							m_selection = {seq, seq};
 						}
 					}
-					else
+
+					ImDrawList *draw_list = ImGui::GetWindowDrawList();
+					if (m_selection && seq >= std::min(m_selection->first, m_selection->second) && seq <= std::max(m_selection->first, m_selection->second))
 					{
-						std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
-						colors = details::simple_colors_split(filter, msg, m_colors.matching_text);
+						draw_list->AddRectFilled(origin, ImVec2(origin.x + item_size.x, origin.y + item_size.y), selection_color);
 					}
-#else
-					std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
-					colors = details::simple_colors_split(filter, msg, m_colors.matching_text);
-#endif
-					if (colors.empty())
+					if (msg.progress >= 0.f)
 					{
-						return;
+						const float progress_width = item_size.x * std::min(msg.progress, 1.f);
+						draw_list->AddRectFilled(origin, ImVec2(origin.x + progress_width, origin.y + item_size.y), progress_color);
 					}
 
-					unsigned int msg_col_pop = 0u;
-					for (const auto &color : colors)
+					if (layout.runs_generation != m_runs_generation)
 					{
-						if (color.first == msg.value.begin() + msg.color_beg)
+						compute_color_runs(seq, msg, prefix_len, layout.runs);
+						layout.runs_generation = m_runs_generation;
+					}
+
+					const std::optional<theme::constexpr_color> *message_color = &m_colors.log_level_colors[msg.severity];
+					if (msg.is_term_message && msg.severity == message::severity::trace)
+					{
+						message_color = &m_colors.cmd_backlog;
+					}
+					else if (msg.is_term_message && msg.severity == message::severity::debug)
+					{
+						message_color = &m_colors.cmd_history_completed;
+					}
+					const ImU32 colored_text_color = *message_color ? ImGui::GetColorU32((*message_color)->imv4()) : text_color;
+
+					if (m_show_timestamps)
+					{
+						char age[32];
+						details::format_age(log_store::clock::now() - store().timestamp(seq), age);
+						draw_list->AddText(font, font_size, origin, ImGui::GetColorU32(ImGuiCol_TextDisabled), age);
+					}
+
+					auto run = layout.runs.cbegin();
+					ImVec2 pos = origin;
+					for (const auto &[row_beg, row_end] : layout.rows)
+					{
+						while (run != layout.runs.cend() && run->end <= row_beg)
+						{
+							++run;
+						}
+						pos.x = origin.x + time_gutter;
+						for (auto it = run; it != layout.runs.cend() && it->begin < row_end; ++it)
 						{
-							if (msg.is_term_message)
+							const unsigned long beg = std::max(it->begin, row_beg);
+							const unsigned long end = std::min(it->end, row_end);
+							if (beg < end)
 							{
-								if (msg.severity == message::severity::trace)
+								using style_flag = message::style_run::flag;
+								ImU32 color = it->foreground != 0u ? it->foreground : it->colored ? colored_text_color : text_color;
+								ImU32 background = it->background;
+								if (it->style_flags & style_flag::inverse)
 								{
-									msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.cmd_backlog);
-									text_formatted("[%d] ", static_cast<int>(traced_count + m_last_flush_at_history - m_command_history.size()));
-									++traced_count;
-									ImGui::SameLine(0.f, 0.f);
+									background = color;
+									color = it->background != 0u ? it->background : background_color;
 								}
-								else if (msg.severity == message::severity::debug)
+								if (it->matched && m_colors.matching_text)
 								{
-									msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.cmd_history_completed);
+									color = matching_text_color;
 								}
-								else
+								if (it->style_flags & style_flag::dim)
 								{
-									msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.log_level_colors[msg.severity]);
+									color = (color & ~IM_COL32_A_MASK) | ((color >> IM_COL32_A_SHIFT & 0xFFu) / 2u << IM_COL32_A_SHIFT);
 								}
-							}
-							else
-							{
-								msg_col_pop += try_push_style(ImGuiCol_Text, m_colors.log_level_colors[msg.severity]);
+
+								const float width = font->CalcTextSizeA(font_size, std::numeric_limits<float>::max(), 0.f, text.data() + beg, text.data() + end).x;
+								if (background != 0u)
+								{
+									draw_list->AddRectFilled(pos, ImVec2(pos.x + width, pos.y + row_height), background);
+								}
+								draw_list->AddText(font, font_size, pos, color, text.data() + beg, text.data() + end);
+								if (it->style_flags & style_flag::bold)
+								{
+									draw_list->AddText(font, font_size, ImVec2(pos.x + 1.f, pos.y), color, text.data() + beg, text.data() + end);
+								}
+								if (it->style_flags & style_flag::underline)
+								{
+									draw_list->AddLine(ImVec2(pos.x, pos.y + font_size), ImVec2(pos.x + width, pos.y + font_size), color);
+								}
+								if (it->style_flags & style_flag::strikethrough)
+								{
+									draw_list->AddLine(ImVec2(pos.x, pos.y + font_size * .5f), ImVec2(pos.x + width, pos.y + font_size * .5f), color);
+								}
+								pos.x += width;
 							}
 						}
-						if (color.first == msg.value.begin() + msg.color_end)
-						{
-							ImGui::PopStyleColor(msg_col_pop);
-							msg_col_pop = 0u;
-						}
-						if (color.second.first != 0)
-						{
-							const int pop = try_push_style(ImGuiCol_Text, color.second.second);
-							text_formatted("%.*s", color.second.first, &*color.first);
-							ImGui::PopStyleColor(pop);
-							ImGui::SameLine(0.f, 0.f);
-						}
+						pos.y += row_height;
 					}
-					ImGui::PopStyleColor(msg_col_pop);
-					ImGui::NewLine();
 				};
-				if (m_current_log_oldest_idx < m_logs.size())
+
+				// messages in view are found by binary search, the others are replaced by a dummy item above and below them
+				auto skip = [&](double from, double to)
 				{
-					for (size_t i = m_current_log_oldest_idx; i < m_logs.size(); ++i)
-					{
-						print_single_message(m_logs[i]);
-					}
-					for (size_t i = 0u; i < m_current_log_oldest_idx; ++i)
+					if (to > from)
 					{
-						print_single_message(m_logs[i]);
+						ImGui::Dummy(ImVec2(time_gutter + m_rows_width, static_cast<float>(to - from) - item_spacing));
 					}
+				};
+				std::size_t index = index_at(visible_top - origin_y);
+				skip(top_of(first_index), top_of(index));
+				for (; index < m_visible_seqs.size() && origin_y + top_of(index) <= visible_bottom; ++index)
+				{
+					print_single_message(index);
+				}
+				skip(top_of(index), top_of(m_visible_seqs.size()));
+
+				if (m_selection && ImGui::IsWindowFocused() && ImGui::GetIO().KeyCtrl && ImGui::IsKeyPressedMap(ImGuiKey_C))
+				{
+					copy_selection();
 				}
 			}
 			if (m_autoscroll)
 			{
-				if (m_last_size != m_logs.size())
+				if (m_last_seq != store().end_seq() || rows_measured)
 				{
 					ImGui::SetScrollHereY(1.f);
-					m_last_size = m_logs.size();
+					m_last_seq = store().end_seq();
 				}
 			}
 			else
 			{
-				m_last_size = 0u;
+				m_last_seq = 0u;
 			}
 			ImGui::PopStyleColor(style_push_count);
 			ImGui::EndChild();
@@ -838,33 +1210,460 @@ namespace ImTerm
 	}
 
 	template <typename TerminalHelper>
-	void terminal<TerminalHelper>::display_command_line() noexcept
+	bool terminal<TerminalHelper>::update_visible_messages()
 	{
-		if (!m_command_entered && ImGui::GetActiveID() == m_input_text_id && m_input_text_id != 0 && m_current_autocomplete.empty())
-		{
-			if (m_autocomplete_pos != position::nowhere && m_buffer_usage == 0u && m_current_autocomplete_strings.empty())
+		const details::view_key key{m_filter_generation, m_level + m_lowest_log_level_val, m_channel, store().channel_count(), store().field_count(), m_match_case};
+		if (key != m_visible_key)
+		{
+			// filter, level or channel changed: starting over
+			IMTERM_TRACE_SCOPE("terminal::update_visible_messages (rebuild)");
+			const bool match_case_changed = key.match_case != m_visible_key.match_case;
+			m_visible_key = key;
+			m_visible_seqs.clear();
+			m_visible_inputs.clear();
+			m_visible_end = 0u;
+			reset_rows();
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+			m_visible_scan_begin = store().first_seq();
+#endif
+
+			std::string_view filter{m_log_text_filter_buffer.data(), m_log_text_filter_buffer_usage};
+			m_query = log_query::parse(filter, !m_match_case);
+			m_query.resolve(store());
+			const bool structured = m_query.structured();
+			const std::string_view highlight = structured ? m_query.highlight() : filter;
+			if (highlight != m_highlight || structured != m_structured_filter || match_case_changed)
 			{
-				m_current_autocomplete = m_t_helper->list_commands();
+				m_highlight.assign(highlight.data(), highlight.size());
+				m_structured_filter = structured;
+				++m_runs_generation;
 			}
+#ifdef IMTERM_ENABLE_REGEX
+			m_regex_filter.reset();
+			if (m_regex_search && !structured && !filter.empty())
+			{
+				try
+				{
+					m_regex_filter.emplace(filter.begin(), filter.end(), m_match_case ? std::regex::ECMAScript : std::regex::ECMAScript | std::regex::icase);
+				}
+				catch (const std::regex_error &)
+				{
+					// malformed regex is treated as no match
+				}
+			}
+#endif
 		}
 
-		ImGui::Separator();
-		show_input_text();
-		handle_unfocus();
-		show_autocomplete();
-	}
-
-	template <typename TerminalHelper>
-	void terminal<TerminalHelper>::show_input_text() noexcept
-	{
-		ImGui::PushItemWidth(-1.f);
-		if (m_should_take_focus)
+		const log_store::seq_type first_seq = store().first_seq();
+		const log_store::seq_type end_seq = store().end_seq();
+		while (!m_visible_seqs.empty() && m_visible_seqs.front() < first_seq)
 		{
-			ImGui::SetKeyboardFocusHere();
-			m_should_take_focus = false;
-		}
-		m_previous_buffer_usage = m_buffer_usage;
-
+			m_visible_seqs.pop_front();
+			if (!m_rows.empty() && m_rows.front().traced == 0u)
+			{
+				m_rows_top = m_rows.front().bottom;
+				m_rows.pop_front();
+			}
+			else
+			{
+				reset_rows(); // a user input was dropped: the following ones are numbered again
+			}
+		}
+		while (!m_visible_inputs.empty() && m_visible_inputs.front() < first_seq)
+		{
+			m_visible_inputs.pop_front();
+		}
+		const bool channel_view = m_channel && *m_channel != log_store::no_channel && *m_channel < store().channel_count();
+		const auto level = m_level + m_lowest_log_level_val;
+
+		// only reads shared state, and may be called from several threads
+		// deferred texts are only formatted for messages passing the level and channel
+		auto passes = [&](log_store::seq_type seq)
+		{
+			const message &msg = store().peek(seq);
+			if (msg.severity < level && !msg.is_term_message)
+			{
+				return false;
+			}
+			if (channel_view && msg.channel != *m_channel && msg.channel != log_store::no_channel)
+			{
+				return false;
+			}
+			if (m_structured_filter)
+			{
+				if (!m_query.matches(store(), seq))
+				{
+					return false;
+				}
+			}
+			else if (!m_highlight.empty())
+			{
+#ifdef IMTERM_ENABLE_REGEX
+				if (m_regex_search)
+				{
+					if (!m_regex_filter || !std::regex_search(store().get(seq).value, *m_regex_filter))
+					{
+						return false;
+					}
+				}
+				else
+#endif
+				if (!search::contains(store().get(seq).value, m_highlight, !m_match_case))
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// updated messages are laid out again, and filtered again if they already were
+		const bool updates_known = store().for_each_update(m_update_count, [&](log_store::seq_type seq)
+														   {
+															   if (seq < first_seq)
+															   {
+																   return;
+															   }
+															   if (seq - m_layouts_first_seq < m_layouts.size())
+															   {
+																   m_layouts[static_cast<std::size_t>(seq - m_layouts_first_seq)] = {};
+															   }
+															   if (seq >= m_visible_end)
+															   {
+																   return;
+															   }
+															   auto it = std::lower_bound(m_visible_seqs.begin(), m_visible_seqs.end(), seq);
+															   const auto index = static_cast<std::size_t>(it - m_visible_seqs.begin());
+															   const bool listed = it != m_visible_seqs.end() && *it == seq;
+															   const bool passing = passes(seq);
+															   if (listed && !passing)
+															   {
+																   m_visible_seqs.erase(it);
+															   }
+															   else if (!listed && passing)
+															   {
+																   m_visible_seqs.insert(it, seq);
+															   }
+															   else if (!listed)
+															   {
+																   return;
+															   }
+															   auto input_it = std::lower_bound(m_visible_inputs.begin(), m_visible_inputs.end(), seq);
+															   const bool input_listed = input_it != m_visible_inputs.end() && *input_it == seq;
+															   const bool input = passing && details::is_user_input(store().peek(seq));
+															   if (input_listed && !input)
+															   {
+																   m_visible_inputs.erase(input_it);
+															   }
+															   else if (!input_listed && input)
+															   {
+																   m_visible_inputs.insert(input_it, seq);
+															   }
+															   // following messages are measured again
+															   m_rows.resize(std::min(m_rows.size(), index));
+														   });
+		m_update_count = store().update_count();
+		if (!updates_known)
+		{
+			// too many updates to track them one by one: starting over
+			m_layouts.clear();
+			m_visible_seqs.clear();
+			m_visible_inputs.clear();
+			m_visible_end = 0u;
+			reset_rows();
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+			m_visible_scan_begin = first_seq;
+#endif
+		}
+
+		const log_store::seq_type from = std::max(m_visible_end, first_seq);
+		m_visible_end = end_seq;
+		if (from == end_seq)
+		{
+			return false;
+		}
+		IMTERM_TRACE_SCOPE("terminal::update_visible_messages (filter)");
+
+		auto check = [&](log_store::seq_type seq)
+		{
+			if (passes(seq))
+			{
+				m_visible_seqs.push_back(seq);
+				if (details::is_user_input(store().peek(seq)))
+				{
+					m_visible_inputs.push_back(seq);
+				}
+			}
+		};
+
+		auto seqs_from = [from](const std::deque<log_store::seq_type> &seqs)
+		{
+			return std::lower_bound(seqs.cbegin(), seqs.cend(), from);
+		};
+
+		const log_query::term *index_term = m_structured_filter ? m_query.index_term() : nullptr;
+		if (index_term != nullptr && index_term->type == log_query::term::kind::field)
+		{
+			// only messages having the field are candidates
+			const std::deque<log_store::field_value> &values = store().field_values(index_term->field);
+			auto it = std::lower_bound(values.cbegin(), values.cend(), from, [](const log_store::field_value &value, log_store::seq_type seq)
+									   { return value.seq < seq; });
+			for (; it != values.cend(); ++it)
+			{
+				if (it == values.cbegin() || std::prev(it)->seq != it->seq)
+				{
+					check(it->seq);
+				}
+			}
+		}
+		else if (index_term != nullptr && index_term->type == log_query::term::kind::channel)
+		{
+			const std::deque<log_store::seq_type> &seqs = store().channel_seqs(index_term->channel);
+			std::for_each(seqs_from(seqs), seqs.cend(), check);
+		}
+		else if (channel_view)
+		{
+			// merging the channel's messages with those having no channel, which are displayed in every channel
+			const std::deque<log_store::seq_type> &channel_seqs = store().channel_seqs(*m_channel);
+			const std::deque<log_store::seq_type> &common_seqs = store().channel_seqs(log_store::no_channel);
+			auto channel_it = seqs_from(channel_seqs);
+			auto common_it = seqs_from(common_seqs);
+			while (channel_it != channel_seqs.cend() || common_it != common_seqs.cend())
+			{
+				if (common_it == common_seqs.cend() || (channel_it != channel_seqs.cend() && *channel_it < *common_it))
+				{
+					check(*channel_it++);
+				}
+				else
+				{
+					check(*common_it++);
+				}
+			}
+		}
+		else
+		{
+#ifdef IMTERM_ENABLE_TRIGRAM_INDEX
+			// text every displayed message must contain (regex filters are only usable when they are plain text)
+			std::string_view literal = m_structured_filter ? m_query.highlight() : std::string_view{m_highlight};
+#ifdef IMTERM_ENABLE_REGEX
+			if (!m_structured_filter && m_regex_search && m_highlight.find_first_of("\\^$.|?*+()[]{}") != std::string::npos)
+			{
+				literal = {};
+			}
+#endif
+			if (store().for_each_candidate(literal, from, check))
+			{
+				return false;
+			}
+#endif
+#ifdef IMTERM_ENABLE_PARALLEL_FILTER
+			if (end_seq - from > details::parallel_filter_chunk)
+			{
+				// a round of chunks is filtered by the thread pool, show() running rounds for a limited time per frame. The panel
+				// shows partial results (and a progress bar) until the scan is over
+				IMTERM_TRACE_SCOPE("terminal::update_visible_messages (parallel)");
+				thread_pool &pool = details::filter_pool();
+				const auto chunk_count = static_cast<std::size_t>(std::min<log_store::seq_type>(
+					(end_seq - from + details::parallel_filter_chunk - 1) / details::parallel_filter_chunk, 4u * (pool.worker_count() + 1u)));
+				m_filter_chunks.resize(std::max(m_filter_chunks.size(), chunk_count));
+				pool.run(chunk_count, [&](std::size_t chunk)
+						 {
+							 std::vector<log_store::seq_type> &out = m_filter_chunks[chunk];
+							 out.clear();
+							 const log_store::seq_type chunk_end = std::min(from + (chunk + 1) * details::parallel_filter_chunk, end_seq);
+							 for (log_store::seq_type s = from + chunk * details::parallel_filter_chunk; s < chunk_end; ++s)
+							 {
+								 if (passes(s))
+								 {
+									 out.push_back(s);
+								 }
+							 }
+						 });
+				for (std::size_t chunk = 0u; chunk < chunk_count; ++chunk)
+				{
+					m_visible_seqs.insert(m_visible_seqs.end(), m_filter_chunks[chunk].cbegin(), m_filter_chunks[chunk].cend());
+					std::copy_if(m_filter_chunks[chunk].cbegin(), m_filter_chunks[chunk].cend(), std::back_inserter(m_visible_inputs),
+								 [this](log_store::seq_type seq)
+								 { return details::is_user_input(store().peek(seq)); });
+				}
+				m_visible_end = std::min(from + chunk_count * details::parallel_filter_chunk, end_seq);
+				return m_visible_end < end_seq;
+			}
+#endif
+			for (log_store::seq_type seq = from; seq < end_seq; ++seq)
+			{
+				check(seq);
+			}
+		}
+		return false;
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::compute_color_runs(log_store::seq_type seq, const message &msg, unsigned long prefix_len, std::vector<details::color_run> &runs) const
+	{
+		// split functions only ever use the passed color for text matching the filter
+		constexpr std::optional<theme::constexpr_color> matched_marker = theme::constexpr_color{0.f, 0.f, 0.f, 0.f};
+
+		std::map<std::string::const_iterator, std::pair<unsigned long, std::optional<theme::constexpr_color>>> colors;
+#ifdef IMTERM_ENABLE_REGEX
+		if (m_regex_search && !m_structured_filter)
+		{
+			if (m_regex_filter)
+			{
+				colors = details::regex_colors_split(m_highlight, *m_regex_filter, msg, matched_marker);
+			}
+			else if (m_highlight.empty())
+			{
+				colors = details::simple_colors_split(m_highlight, msg, matched_marker);
+			}
+		}
+		else
+		{
+			colors = details::simple_colors_split(m_highlight, msg, matched_marker, !m_match_case);
+		}
+#else
+		colors = details::simple_colors_split(m_highlight, msg, matched_marker, !m_match_case);
+#endif
+		details::to_color_runs(colors, msg, runs);
+		const auto [first_style, last_style] = store().style_runs(seq);
+		details::apply_style_runs(first_style, last_style, runs);
+
+		if (prefix_len != 0u)
+		{
+			auto first_shifted = std::find_if(runs.begin(), runs.end(), [&msg](const details::color_run &run)
+											  { return run.begin >= msg.color_beg; });
+			std::for_each(first_shifted, runs.end(), [prefix_len](details::color_run &run)
+						  {
+							  run.begin += prefix_len;
+							  run.end += prefix_len;
+						  });
+			runs.insert(first_shifted, {msg.color_beg, msg.color_beg + prefix_len, true, false});
+		}
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::copy_selection()
+	{
+		if (!m_selection)
+		{
+			return;
+		}
+		const log_store::seq_type sel_beg = std::max(std::min(m_selection->first, m_selection->second), store().first_seq());
+		const log_store::seq_type sel_end = std::min(std::max(m_selection->first, m_selection->second) + 1, store().end_seq());
+
+		std::string copied;
+		for (log_store::seq_type seq = sel_beg; seq < sel_end; ++seq)
+		{
+			copied += store().get(seq).value;
+			copied += '\n';
+		}
+		ImGui::SetClipboardText(copied.c_str());
+	}
+
+	template <typename TerminalHelper>
+	details::message_layout &terminal<TerminalHelper>::layout_message(details::message_layout &layout, std::string_view text, unsigned long prefix_len, float wrap_width) const
+	{
+		const ImFont *font = ImGui::GetFont();
+		const float font_size = ImGui::GetFontSize();
+		if (layout.font == font && layout.font_size == font_size && layout.wrap_width == wrap_width && layout.prefix_len == prefix_len)
+		{
+			return layout;
+		}
+
+		if (layout.prefix_len != prefix_len)
+		{
+			layout.runs_generation = 0u; // runs are shifted by the prefix
+		}
+		layout.font = font;
+		layout.font_size = font_size;
+		layout.wrap_width = wrap_width;
+		layout.prefix_len = prefix_len;
+		layout.max_row_width = 0.f;
+		layout.rows.clear();
+
+		const float scale = font_size / font->FontSize;
+		const char *const text_beg = text.data();
+		const char *const text_end = text_beg + text.size();
+		const char *it = text_beg;
+
+		// same line breaking rules as ImGui::TextWrapped
+		do
+		{
+			const char *line_end = static_cast<const char *>(std::memchr(it, '\n', static_cast<std::size_t>(text_end - it)));
+			if (line_end == nullptr)
+			{
+				line_end = text_end;
+			}
+
+			const char *row_end = line_end;
+			if (wrap_width > 0.f && it != line_end)
+			{
+				row_end = font->CalcWordWrapPositionA(scale, it, line_end, wrap_width);
+				if (row_end == it)
+				{
+					// wrap width is too small to fit anything: forcing one character per row
+					do
+					{
+						++row_end;
+					} while (row_end != line_end && (static_cast<unsigned char>(*row_end) & 0xC0u) == 0x80u);
+				}
+			}
+			else if (wrap_width <= 0.f)
+			{
+				layout.max_row_width = std::max(layout.max_row_width, font->CalcTextSizeA(font_size, std::numeric_limits<float>::max(), 0.f, it, line_end).x);
+			}
+			layout.rows.emplace_back(static_cast<unsigned long>(it - text_beg), static_cast<unsigned long>(row_end - text_beg));
+
+			if (row_end == line_end)
+			{
+				it = line_end == text_end ? text_end : line_end + 1;
+			}
+			else
+			{
+				// wrapping skips upcoming blanks
+				it = row_end;
+				while (it != line_end && (*it == ' ' || *it == '\t'))
+				{
+					++it;
+				}
+				if (it == line_end && line_end != text_end)
+				{
+					++it;
+				}
+			}
+		} while (it != text_end);
+
+		return layout;
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::display_command_line() noexcept
+	{
+		if (!m_command_entered && ImGui::GetActiveID() == m_input_text_id && m_input_text_id != 0 && m_core.command_completion().empty())
+		{
+			if (m_autocomplete_pos != position::nowhere && m_buffer_usage == 0u && m_core.argument_completion().empty())
+			{
+				IMTERM_TRACE_SCOPE("terminal::list_commands");
+				m_core.complete_all_commands();
+			}
+		}
+
+		ImGui::Separator();
+		show_input_text();
+		handle_unfocus();
+		show_autocomplete();
+	}
+
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::show_input_text() noexcept
+	{
+		ImGui::PushItemWidth(-1.f);
+		if (m_should_take_focus)
+		{
+			ImGui::SetKeyboardFocusHere();
+			m_should_take_focus = false;
+		}
+		m_previous_buffer_usage = m_buffer_usage;
+
 		if (ImGui::InputText("##terminal:input_text", m_command_buffer.data(), m_command_buffer.size(),
 							 ImGuiInputTextFlags_CallbackCompletion | ImGuiInputTextFlags_CallbackHistory,
 							 terminal::command_line_callback_st, this) &&
@@ -887,51 +1686,11 @@ namespace ImTerm
 			if (m_autocomplete_pos != position::nowhere)
 			{
 
-				int sp_count = 0;
-				auto is_space_lbd = [this, &sp_count](char c)
-				{
-					if (sp_count > 0)
-					{
-						--sp_count;
-						return true;
-					}
-					else
-					{
-						sp_count = is_space({&c, static_cast<unsigned>(m_command_buffer.data() + m_buffer_usage - &c)});
-						if (sp_count > 0)
-						{
-							--sp_count;
-							return true;
-						}
-						return false;
-					}
-				};
-				char *beg = std::find_if_not(m_command_buffer.data(), m_command_buffer.data() + m_buffer_usage,
-											 is_space_lbd);
-				sp_count = 0;
-				const char *ed = std::find_if(beg, m_command_buffer.data() + m_buffer_usage, is_space_lbd);
-
-				if (ed == m_command_buffer.data() + m_buffer_usage)
-				{
-					m_current_autocomplete = m_t_helper->find_commands_by_prefix(beg, ed);
-					m_current_autocomplete_strings.clear();
-					m_command_entered = true;
-				}
-				else
-				{
-					m_command_entered = false;
-					m_current_autocomplete.clear();
-					std::vector<command_type_cref> cmds = m_t_helper->find_commands_by_prefix(beg, ed);
-
-					if (!cmds.empty())
-					{
-						std::string_view sv{m_command_buffer.data(), m_buffer_usage};
-						std::optional<std::vector<std::string>> splitted = split_by_space(sv, true);
-						assert(splitted);
-						argument_type arg{m_argument_value, *this, *splitted};
-						m_current_autocomplete_strings = cmds[0].get().complete(arg);
-					}
-				}
+				m_command_entered = m_core.update_completion({m_command_buffer.data(), m_buffer_usage}, [this](const command_type &cmd, std::vector<std::string> &arguments)
+															 {
+																 argument_type arg{m_argument_value, *this, arguments};
+																 return cmd.complete(arg);
+															 });
 			}
 			else
 			{
@@ -947,6 +1706,40 @@ namespace ImTerm
 		}
 	}
 
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::display_pager() noexcept
+	{
+		command_output &output = m_core.output();
+		if (!output.has_pager())
+		{
+			return;
+		}
+
+		const std::string title = std::string{m_window_name} + " - output##terminal:pager";
+		bool open = true;
+		ImGui::SetNextWindowSize(ImVec2(static_cast<float>(m_base_width), static_cast<float>(m_base_height) * 2.f), ImGuiCond_FirstUseEver);
+		if (ImGui::Begin(title.c_str(), &open))
+		{
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(output.pager_line_count()));
+			while (clipper.Step())
+			{
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+				{
+					const std::string_view line = output.pager_line(static_cast<std::size_t>(i));
+					ImGui::TextUnformatted(line.data(), line.data() + line.size());
+				}
+			}
+			clipper.End();
+		}
+		ImGui::End();
+
+		if (!open)
+		{
+			output.close_pager();
+		}
+	}
+
 	template <typename TerminalHelper>
 	void terminal<TerminalHelper>::handle_unfocus() noexcept
 	{
@@ -957,7 +1750,7 @@ namespace ImTerm
 			m_command_line_backup_prefix.remove_prefix(m_command_line_backup_prefix.size());
 			m_command_line_backup.clear();
 			m_current_history_selection = {};
-			m_current_autocomplete.clear();
+			m_core.clear_completion();
 		};
 
 		if (m_previously_active_id == m_input_text_id && ImGui::GetActiveID() != m_input_text_id)
@@ -993,7 +1786,7 @@ namespace ImTerm
 			return;
 		}
 
-		if ((m_input_text_id == ImGui::GetActiveID() || m_should_take_focus) && (!m_current_autocomplete.empty() || !m_current_autocomplete_strings.empty()))
+		if ((m_input_text_id == ImGui::GetActiveID() || m_should_take_focus) && (!m_core.command_completion().empty() || !m_core.argument_completion().empty()))
 		{
 			m_has_focus = true;
 
@@ -1020,108 +1813,33 @@ namespace ImTerm
 			if (ImGui::Begin("##terminal:auto_complete", nullptr, overlay_flags))
 			{
 
-				auto print_separator = [this]()
-				{
-					ImGui::SameLine(0.f, 0.f);
-					int pop = try_push_style(ImGuiCol_Text, m_colors.auto_complete_separator);
-					ImGui::TextUnformatted(m_autocomlete_separator.data(),
-										   m_autocomlete_separator.data() + m_autocomlete_separator.size());
-					ImGui::PopStyleColor(pop);
-					ImGui::SameLine(0.f, 0.f);
-				};
-
-				int max_displayable_sv = 0;
-				float separator_length = ImGui::CalcTextSize(m_autocomlete_separator.data(),
-															 m_autocomlete_separator.data() + m_autocomlete_separator.size())
-											 .x;
-				float total_text_length = ImGui::CalcTextSize("...").x;
-
-				std::vector<std::string_view> autocomplete_text;
-				if (m_current_autocomplete_strings.empty())
-				{
-					autocomplete_text.reserve(m_current_autocomplete.size());
-					for (const command_type &cmd : m_current_autocomplete)
-					{
-						autocomplete_text.emplace_back(cmd.name);
-					}
-				}
-				else
-				{
-					autocomplete_text.reserve(m_current_autocomplete_strings.size());
-					for (const std::string &str : m_current_autocomplete_strings)
-					{
-						autocomplete_text.emplace_back(str);
-					}
-				}
-
-				for (const std::string_view &sv : autocomplete_text)
+				// the candidates that fit in the overlay and their position are only computed again when the completion, the
+				// overlay's width or the font changes. Other frames only write them to the draw list, with the current colors
+				ImFont *font = ImGui::GetFont();
+				const float font_size = ImGui::GetFontSize();
+				if (m_osd.completion_generation != m_core.completion_generation() || m_osd.max_width != auto_complete_max_size.x || m_osd.font != font || m_osd.font_size != font_size)
 				{
-					float t_len = ImGui::CalcTextSize(sv.data(), sv.data() + sv.size()).x + separator_length;
-					if (t_len + total_text_length < auto_complete_max_size.x)
-					{
-						total_text_length += t_len;
-						++max_displayable_sv;
-					}
-					else
-					{
-						break;
-					}
+					IMTERM_TRACE_SCOPE("terminal::show_autocomplete (layout)");
+					layout_autocomplete(auto_complete_max_size.x, font, font_size);
 				}
 
-				std::string_view last;
-				int pop_count = 0;
+				const ImVec2 origin = ImGui::GetCursorScreenPos();
+				ImGui::Dummy(ImVec2(m_osd.width, ImGui::GetTextLineHeight()));
 
-				if (max_displayable_sv != 0)
+				const ImU32 text_color = ImGui::GetColorU32(ImGuiCol_Text);
+				auto color_of = [text_color](const std::optional<theme::constexpr_color> &color)
 				{
-					const std::string_view &first = autocomplete_text[0];
-					pop_count += try_push_style(ImGuiCol_Text, m_colors.auto_complete_selected);
-					ImGui::TextUnformatted(first.data(), first.data() + first.size());
-					pop_count += try_push_style(ImGuiCol_Text, m_colors.auto_complete_non_selected);
-					for (int i = 1; i < max_displayable_sv; ++i)
-					{
-						const std::string_view vs = autocomplete_text[i];
-						print_separator();
-						ImGui::TextUnformatted(vs.data(), vs.data() + vs.size());
-					}
-					ImGui::PopStyleColor(pop_count);
-					if (max_displayable_sv < static_cast<long>(autocomplete_text.size()))
-					{
-						last = autocomplete_text[max_displayable_sv];
-					}
-				}
+					return color ? ImGui::GetColorU32(color->imv4()) : text_color;
+				};
+				const ImU32 piece_colors[] = {color_of(m_colors.auto_complete_selected), color_of(m_colors.auto_complete_non_selected),
+											  color_of(m_colors.auto_complete_separator)};
 
-				pop_count = 0;
-				if (max_displayable_sv < static_cast<long>(autocomplete_text.size()))
+				ImDrawList *draw_list = ImGui::GetWindowDrawList();
+				for (const details::osd_piece &piece : m_osd.pieces)
 				{
-
-					if (max_displayable_sv == 0)
-					{
-						last = autocomplete_text.front();
-						pop_count += try_push_style(ImGuiCol_Text, m_colors.auto_complete_selected);
-						total_text_length -= separator_length;
-					}
-					else
-					{
-						pop_count += try_push_style(ImGuiCol_Text, m_colors.auto_complete_non_selected);
-						print_separator();
-					}
-
-					std::vector<char> buf;
-					buf.resize(last.size() + 4);
-					std::copy(last.begin(), last.end(), buf.begin());
-					std::fill(buf.begin() + last.size(), buf.end(), '.');
-					auto size = static_cast<unsigned>(last.size() + 3);
-					while (size >= 4 && total_text_length + ImGui::CalcTextSize(buf.data(), buf.data() + size).x >= auto_complete_max_size.x)
-					{
-						buf[size - 4] = '.';
-						--size;
-					}
-					while (size != 0 && total_text_length + ImGui::CalcTextSize(buf.data(), buf.data() + size).x >= auto_complete_max_size.x)
-					{
-						--size;
-					}
-					ImGui::TextUnformatted(buf.data(), buf.data() + size);
-					ImGui::PopStyleColor(pop_count);
+					const std::string_view text = piece.truncated ? std::string_view{m_osd.truncated_text} : piece.text;
+					draw_list->AddText(font, font_size, ImVec2(origin.x + piece.x, origin.y), piece_colors[static_cast<int>(piece.type)],
+									   text.data(), text.data() + text.size());
 				}
 			}
 			ImGui::End();
@@ -1130,402 +1848,121 @@ namespace ImTerm
 	}
 
 	template <typename TerminalHelper>
-	void terminal<TerminalHelper>::call_command() noexcept
+	void terminal<TerminalHelper>::layout_autocomplete(float max_width, const ImFont *font, float font_size)
 	{
-		if (m_buffer_usage == 0)
-		{
-			return;
-		}
-
-		m_current_autocomplete_strings.clear();
-		m_current_autocomplete.clear();
-
-		bool modified{};
-		std::pair<bool, std::string> resolved = resolve_history_references({m_command_buffer.data(), m_buffer_usage}, modified);
+		m_osd.completion_generation = m_core.completion_generation();
+		m_osd.max_width = max_width;
+		m_osd.font = font;
+		m_osd.font_size = font_size;
+		m_osd.pieces.clear();
+		m_osd.truncated_text.clear();
 
-		if (!resolved.first)
+		auto text_width = [](std::string_view text)
 		{
-			try_log(R"(No such event: )" + resolved.second, message::type::error);
-			return;
-		}
-
-		std::optional<std::vector<std::string>> splitted = split_by_space(resolved.second);
-		if (!splitted)
-		{
-			try_log({m_command_buffer.data(), m_buffer_usage}, message::type::user_input);
-			try_log("Unmatched \"", message::type::error);
-			return;
-		}
-
-		try_log({m_command_buffer.data(), m_buffer_usage}, message::type::user_input);
-		if (splitted->empty())
-		{
-			return;
-		}
-		if (modified)
-		{
-			try_log("> " + resolved.second, message::type::cmd_history_completion);
-		}
-
-		std::vector<command_type_cref> matching_command_list = m_t_helper->find_commands_by_prefix(splitted->front());
-		if (matching_command_list.empty())
-		{
-			splitted->front() += ": command not found";
-			try_log(splitted->front(), message::type::error);
-			m_command_history.emplace_back(std::move(resolved.second));
-			return;
-		}
-
-		argument_type arg{m_argument_value, *this, *splitted};
-
-		matching_command_list[0].get().call(arg);
-		m_command_history.emplace_back(std::move(resolved.second)); // resolved.second has ownership over *splitted
-	}
-
-	template <typename TerminalHelper>
-	std::pair<bool, std::string> terminal<TerminalHelper>::resolve_history_references(std::string_view str, bool &modified) const
-	{
-		enum class state
-		{
-			nothing, // matched nothing
-			part_1,	 // matched one char: '!'
-			part_2,	 // matched !-
-			part_3,	 // matched !-[n]
-			part_4,	 // matched !-[n]:
-			finalize // matched !-[n]:[n]
+			return ImGui::CalcTextSize(text.data(), text.data() + text.size()).x;
 		};
+		const float separator_width = text_width(m_autocomlete_separator);
+		float total_text_length = text_width("...");
+		float x = 0.f;
 
-		modified = false;
-		if (str.empty())
-		{
-			return {true, {}};
-		}
-
-		if (str.size() == 1)
-		{
-			return {(str[0] != '!'), {str.data(), str.size()}};
-		}
-
-		std::string ans;
-		ans.reserve(str.size());
-
-		auto substr_beg = str.data();
-		auto it = substr_beg;
-
-		state current_state = state::nothing;
-
-		auto resolve = [&](std::string_view history_request, bool add_escaping = true) -> bool
+		// candidates are measured until one doesn't fit
+		std::optional<std::string_view> last;
+		auto fits = [&](std::string_view candidate)
 		{
-			bool local_modified{};
-			std::optional<std::string> solved = resolve_history_reference(history_request, local_modified);
-			if (!solved)
+			const float width = text_width(candidate);
+			if (width + separator_width + total_text_length >= max_width)
 			{
+				last = candidate;
 				return false;
 			}
-
-			auto is_space_lbd = [&solved, this](char c)
-			{
-				return is_space({&c, static_cast<unsigned>(&solved.value()[solved->size() - 1] + 1 - &c)}) > 0;
-			};
-
-			modified |= local_modified;
-			if (add_escaping)
-			{
-				if (solved->empty())
-				{
-					ans += R"("")";
-				}
-				else if (std::find_if(solved->begin(), solved->end(), is_space_lbd) != solved->end())
-				{
-					ans += '"';
-					ans += *solved;
-					ans += '"';
-				}
-				else
-				{
-					ans += *solved;
-				}
-			}
-			else
+			if (!m_osd.pieces.empty())
 			{
-				ans += *solved;
+				m_osd.pieces.push_back({m_autocomlete_separator, x, details::osd_piece::kind::separator});
+				x += separator_width;
 			}
-			substr_beg = std::next(it);
-			current_state = state::nothing;
+			m_osd.pieces.push_back({candidate, x, m_osd.pieces.empty() ? details::osd_piece::kind::selected : details::osd_piece::kind::other});
+			x += width;
+			total_text_length += width + separator_width;
 			return true;
 		};
-
-		const char *const end = str.data() + str.size();
-		while (it != end)
+		if (m_core.argument_completion().empty())
 		{
-
-			if (*it == '\\')
+			for (const command_type &cmd : m_core.command_completion())
 			{
-				do
-				{
-					++it;
-					if (it != end)
-					{
-						++it;
-					}
-				} while (it != end && *it == '\\');
-
-				if (current_state != state::nothing)
-				{
-					return {false, {substr_beg, it}};
-				}
-
-				if (it == end)
+				if (!fits(cmd.name))
 				{
 					break;
 				}
 			}
-
-			switch (current_state)
-			{
-			case state::nothing:
-				if (*it == '!')
-				{
-					current_state = state::part_1;
-					ans += std::string_view{substr_beg, static_cast<unsigned>(it - substr_beg)};
-					substr_beg = it;
-				}
-				break;
-
-			case state::part_1:
-				if (*it == '-')
-				{
-					current_state = state::part_2;
-				}
-				else if (*it == ':')
-				{
-					current_state = state::part_4;
-				}
-				else if (*it == '!')
-				{
-					if (!resolve("!!", false))
-					{
-						return {false, "!!"};
-					}
-				}
-				else
-				{
-					current_state = state::nothing;
-				}
-				break;
-			case state::part_2:
-				if (is_digit(*it))
-				{
-					current_state = state::part_3;
-				}
-				else
-				{
-					return {false, {substr_beg, it}};
-				}
-				break;
-			case state::part_3:
-				if (*it == ':')
-				{
-					current_state = state::part_4;
-				}
-				else if (!is_digit(*it))
-				{
-					if (!resolve({substr_beg, static_cast<unsigned>(it - substr_beg)}, false))
-					{
-						return {false, {substr_beg, it}};
-					}
-				}
-				break;
-			case state::part_4:
-				if (is_digit(*it))
-				{
-					current_state = state::finalize;
-				}
-				else if (*it == '*')
-				{
-					if (!resolve({substr_beg, static_cast<unsigned>(it + 1 - substr_beg)}, false))
-					{
-						return {false, {substr_beg, it}};
-					}
-				}
-				else
-				{
-					return {false, {substr_beg, it}};
-				}
-				break;
-			case state::finalize:
-				if (!is_digit(*it))
-				{
-					if (!resolve({substr_beg, static_cast<unsigned>(it - substr_beg)}))
-					{
-						return {false, {substr_beg, it}};
-					}
-					substr_beg = it;
-					continue; // we should loop without incrementing the pointer ; current character was not parsed
-				}
-				break;
-			}
-
-			++it;
 		}
-
-		bool escape = true;
-		if (substr_beg != it)
+		else
 		{
-			switch (current_state)
+			for (const std::string &str : m_core.argument_completion())
 			{
-			case state::nothing:
-				[[fallthrough]];
-			case state::part_1:
-				ans += std::string_view{substr_beg, static_cast<unsigned>(it - substr_beg)};
-				break;
-			case state::part_2:
-				[[fallthrough]];
-			case state::part_4:
-				return {false, {substr_beg, it}};
-			case state::part_3:
-				escape = false;
-				[[fallthrough]];
-			case state::finalize:
-				if (!resolve({substr_beg, static_cast<unsigned>(it - substr_beg)}, escape))
+				if (!fits(str))
 				{
-					return {false, {substr_beg, it}};
+					break;
 				}
-				break;
 			}
 		}
 
-		return {true, std::move(ans)};
-	}
-
-	template <typename TerminalHelper>
-	std::optional<std::string> terminal<TerminalHelper>::resolve_history_reference(std::string_view str, bool &modified) const noexcept
-	{
-		modified = false;
-
-		if (str.empty() || str[0] != '!')
-		{
-			return std::string{str.begin(), str.end()};
-		}
-
-		if (str.size() < 2)
+		if (last)
 		{
-			return {};
-		}
-
-		if (str[1] == '!')
-		{
-			if (m_command_history.empty() || str.size() != 2)
+			// the first candidate that didn't fit is shortened: whole code points are dropped from its end, then the dots
+			details::osd_piece::kind type = details::osd_piece::kind::selected;
+			if (m_osd.pieces.empty())
 			{
-				return {};
+				total_text_length -= separator_width;
 			}
 			else
 			{
-				modified = true;
-				return {m_command_history.back()};
-			}
-		}
-
-		// ![stuff]
-		unsigned int backward_jump = 1;
-		unsigned int char_idx = 1;
-		if (str[1] == '-')
-		{
-			if (str.size() <= 2 || !is_digit(str[2]))
-			{
-				return {};
+				m_osd.pieces.push_back({m_autocomlete_separator, x, details::osd_piece::kind::separator});
+				x += separator_width;
+				type = details::osd_piece::kind::other;
 			}
 
-			unsigned int val{0};
-			std::from_chars_result res = std::from_chars(str.data() + 2, str.data() + str.size(), val, 10);
-			if (val == 0)
+			std::string &buf = m_osd.truncated_text;
+			std::size_t kept = last->size();
+			std::size_t dots = 3u;
+			auto too_wide = [&]()
 			{
-				return {}; // val == 0  <=> (garbage input || user inputted 0)
-			}
-
-			backward_jump = val;
-			char_idx = static_cast<unsigned int>(res.ptr - str.data());
-		}
-
-		if (m_command_history.size() < backward_jump)
-		{
-			return {};
-		}
-
-		if (char_idx >= str.size())
-		{
-			modified = true;
-			return m_command_history[m_command_history.size() - backward_jump];
-		}
-
-		if (str[char_idx] != ':')
-		{
-			return {};
-		}
-
-		++char_idx;
-		if (str.size() <= char_idx)
-		{
-			return {};
-		}
-
-		if (str[char_idx] == '*')
-		{
-			modified = true;
-			const std::string &cmd = m_command_history[m_command_history.size() - backward_jump];
-
-			int sp_count = 0;
-			auto is_space_lbd = [&sp_count, &cmd, this](char c)
+				buf.assign(last->data(), kept);
+				buf.append(dots, '.');
+				return total_text_length + text_width(buf) >= max_width;
+			};
+			while (kept != 0u && too_wide())
 			{
-				if (sp_count > 0)
-				{
-					--sp_count;
-					return true;
-				}
-				sp_count = is_space({&c, static_cast<unsigned>(&*cmd.end() - &c)});
-				if (sp_count > 0)
+				do
 				{
-					--sp_count;
-					return true;
-				}
-				return false;
-			};
-
-			auto first_non_space = std::find_if_not(cmd.begin(), cmd.end(), is_space_lbd);
-			sp_count = 0;
-			auto first_space = std::find_if(first_non_space, cmd.end(), is_space_lbd);
-			sp_count = 0;
-			first_non_space = std::find_if_not(first_space, cmd.end(), is_space_lbd);
-
-			if (first_non_space == cmd.end())
+					--kept;
+				} while (kept != 0u && utf8::is_continuation((*last)[kept]));
+			}
+			while (dots != 0u && too_wide())
 			{
-				return std::string{""};
+				--dots;
 			}
-			return std::string{first_non_space, cmd.end()};
-		}
-
-		if (!is_digit(str[char_idx]))
-		{
-			return {};
-		}
-
-		unsigned int val1{};
-		std::from_chars_result res1 = std::from_chars(str.data() + char_idx, str.data() + str.size(), val1, 10);
-		if (!misc::success(res1.ec) || res1.ptr != str.data() + str.size())
-		{ // either unsuccessful or we didn't reach the end of the string
-			return {};
+			buf.assign(last->data(), kept);
+			buf.append(dots, '.');
+			m_osd.pieces.push_back({{}, x, type, true});
+			x += text_width(buf);
 		}
+		m_osd.width = x;
+	}
 
-		const std::string &cmd = m_command_history[m_command_history.size() - backward_jump]; // 1 <= backward_jump <= command_history.size()
-		std::optional<std::vector<std::string>> args = split_by_space(cmd);
-
-		if (!args || args->size() <= val1)
+	template <typename TerminalHelper>
+	void terminal<TerminalHelper>::call_command() noexcept
+	{
+		IMTERM_TRACE_SCOPE("terminal::call_command");
+		if (m_buffer_usage == 0)
 		{
-			return {};
+			return;
 		}
 
-		modified = true;
-		return (*args)[val1];
+		m_core.execute({m_command_buffer.data(), m_buffer_usage}, [this](const command_type &cmd, std::vector<std::string> &&arguments)
+					   {
+						   argument_type arg{m_argument_value, *this, std::move(arguments)};
+						   cmd.call(arg);
+					   });
 	}
 
 	template <typename TerminalHelper>
@@ -1563,18 +2000,18 @@ namespace ImTerm
 		if (data->EventKey == ImGuiKey_Tab)
 		{
 			std::vector<std::string_view> autocomplete_text;
-			if (m_current_autocomplete_strings.empty())
+			if (m_core.argument_completion().empty())
 			{
-				autocomplete_text.reserve(m_current_autocomplete.size());
-				for (const command_type &cmd : m_current_autocomplete)
+				autocomplete_text.reserve(m_core.command_completion().size());
+				for (const command_type &cmd : m_core.command_completion())
 				{
 					autocomplete_text.emplace_back(cmd.name);
 				}
 			}
 			else
 			{
-				autocomplete_text.reserve(m_current_autocomplete_strings.size());
-				for (const std::string &str : m_current_autocomplete_strings)
+				autocomplete_text.reserve(m_core.argument_completion().size());
+				for (const std::string &str : m_core.argument_completion())
 				{
 					autocomplete_text.emplace_back(str);
 				}
@@ -1598,7 +2035,8 @@ namespace ImTerm
 				}
 				bool modified{};
 				std::string_view reference{excl, static_cast<unsigned>(m_command_buffer.data() + data->CursorPos - excl)};
-				std::optional<std::string> val = resolve_history_reference(reference, modified);
+				// doesn't reach the history loader: set_history_storage loads the history right away
+				std::optional<std::string> val = m_core.resolve_history_reference(reference, modified);
 				if (!modified)
 				{
 					return 0;
@@ -1606,12 +2044,7 @@ namespace ImTerm
 
 				if (reference.substr(reference.size() - 2) != ":*" && reference.find(':') != std::string_view::npos)
 				{
-					auto is_space_lbd = [&val, this](char c)
-					{
-						return is_space({&c, static_cast<unsigned>(&val.value()[val->size()] + 1 - &c)}) > 0;
-					};
-
-					if (std::find_if(val->begin(), val->end(), is_space_lbd) != val->end())
+					if (m_core.find_space(*val) != val->size())
 					{
 						val = '"' + std::move(*val) + '"';
 					}
@@ -1632,12 +2065,11 @@ namespace ImTerm
 			else
 			{
 				command_beg = misc::find_terminating_word(m_command_buffer.data(), m_command_buffer.data() + m_buffer_usage, [this](std::string_view sv)
-														  { return is_space(sv); });
+														  { return m_core.is_space(sv); });
 				;
 			}
 
-			bool space_found = std::find_if(complete_sv.begin(), complete_sv.end(), [this, &complete_sv](char c)
-											{ return is_space({&c, static_cast<unsigned>(&complete_sv[complete_sv.size() - 1] + 1 - &c)}) > 0; }) != complete_sv.end();
+			bool space_found = m_core.find_space(complete_sv) != complete_sv.size();
 
 			if (space_found)
 			{
@@ -1654,12 +2086,11 @@ namespace ImTerm
 			}
 
 			m_buffer_usage = static_cast<unsigned>(data->BufTextLen);
-			m_current_autocomplete.clear();
-			m_current_autocomplete_strings.clear();
+			m_core.clear_completion();
 		}
 		else if (data->EventKey == ImGuiKey_UpArrow)
 		{
-			if (m_command_history.empty())
+			if (m_core.get_history().empty())
 			{
 				return 0;
 			}
@@ -1668,14 +2099,14 @@ namespace ImTerm
 			if (!m_current_history_selection)
 			{
 
-				m_current_history_selection = m_command_history.end();
+				m_current_history_selection = m_core.get_history().end();
 				m_command_line_backup = std::string(m_command_buffer.data(), m_command_buffer.data() + m_buffer_usage);
 				m_command_line_backup_prefix = m_command_line_backup;
 
 				auto is_space_lbd = [this](unsigned int idx)
 				{
 					const char *ptr = &m_command_line_backup_prefix[idx];
-					return is_space({ptr, static_cast<unsigned>(m_command_line_backup_prefix.size() - idx)});
+					return m_core.is_space({ptr, static_cast<unsigned>(m_command_line_backup_prefix.size() - idx)});
 				};
 				unsigned int idx = 0;
 				int space_count = 0;
@@ -1689,15 +2120,14 @@ namespace ImTerm
 				}
 
 				m_command_line_backup_prefix.remove_prefix(idx);
-				m_current_autocomplete.clear();
-				m_current_autocomplete_strings.clear();
+				m_core.clear_completion();
 			}
 
 			auto it = misc::find_first_prefixed(
-				m_command_line_backup_prefix, std::reverse_iterator(*m_current_history_selection), m_command_history.rend(), [this](std::string_view str)
-				{ return is_space(str); });
+				m_command_line_backup_prefix, std::reverse_iterator(*m_current_history_selection), m_core.get_history().rend(), [this](std::string_view str)
+				{ return m_core.is_space(str); });
 
-			if (it != m_command_history.rend())
+			if (it != m_core.get_history().rend())
 			{
 				m_current_history_selection = std::prev(it.base());
 				paste_buffer((*m_current_history_selection)->begin() + m_command_line_backup_prefix.size(), (*m_current_history_selection)->end(), m_command_line_backup.size());
@@ -1705,7 +2135,7 @@ namespace ImTerm
 			}
 			else
 			{
-				if (m_current_history_selection == m_command_history.end())
+				if (m_current_history_selection == m_core.get_history().end())
 				{
 					// no auto completion occured
 					m_ignore_next_textinput = false;
@@ -1725,10 +2155,10 @@ namespace ImTerm
 			m_ignore_next_textinput = true;
 
 			m_current_history_selection = misc::find_first_prefixed(
-				m_command_line_backup_prefix, std::next(*m_current_history_selection), m_command_history.end(), [this](std::string_view str)
-				{ return is_space(str); });
+				m_command_line_backup_prefix, std::next(*m_current_history_selection), m_core.get_history().end(), [this](std::string_view str)
+				{ return m_core.is_space(str); });
 
-			if (m_current_history_selection != m_command_history.end())
+			if (m_current_history_selection != m_core.get_history().end())
 			{
 				paste_buffer((*m_current_history_selection)->begin() + m_command_line_backup_prefix.size(), (*m_current_history_selection)->end(), m_command_line_backup.size());
 				m_buffer_usage = static_cast<unsigned>(data->BufTextLen);
@@ -1754,155 +2184,4 @@ namespace ImTerm
 
 		return 0;
 	}
-
-	template <typename TerminalHelper>
-	int terminal<TerminalHelper>::is_space(std::string_view str) const
-	{
-		return details::is_space(m_t_helper, str);
-	}
-
-	template <typename TerminalHelper>
-	bool terminal<TerminalHelper>::is_digit(char c) const
-	{
-		return c >= '0' && c <= '9';
-	}
-
-	template <typename TerminalHelper>
-	unsigned long terminal<TerminalHelper>::get_length(std::string_view str) const
-	{
-		return details::get_length(m_t_helper, str);
-	}
-
-	template <typename TerminalHelper>
-	std::optional<std::vector<std::string>> terminal<TerminalHelper>::split_by_space(std::string_view in, bool ignore_non_match) const
-	{
-		std::vector<std::string> out;
-
-		const char *it = &in[0];
-		const char *const in_end = &in[in.size() - 1] + 1;
-
-		auto skip_spaces = [&]()
-		{
-			int space_count;
-			do
-			{
-				space_count = is_space({it, static_cast<unsigned>(in_end - it)});
-				it += space_count;
-			} while (it != in_end && space_count > 0);
-		};
-
-		if (it != in_end)
-		{
-			skip_spaces();
-		}
-
-		if (it == in_end)
-		{
-			return out;
-		}
-
-		bool matched_quote{};
-		bool matched_space{};
-		std::string current_string{};
-		do
-		{
-			if (*it == '"')
-			{
-				bool escaped;
-				do
-				{
-					escaped = (*it == '\\');
-					++it;
-
-					if (it != in_end && (*it != '"' || escaped))
-					{
-						if (*it == '\\')
-						{
-							if (escaped)
-							{
-								current_string += *it;
-							}
-						}
-						else
-						{
-							current_string += *it;
-						}
-					}
-					else
-					{
-						break;
-					}
-
-				} while (true);
-
-				if (it == in_end)
-				{
-					if (!ignore_non_match)
-					{
-						return {};
-					}
-				}
-				else
-				{
-					++it;
-				}
-				matched_quote = true;
-				matched_space = false;
-			}
-			else if (is_space({it, static_cast<unsigned>(in_end - it)}) > 0)
-			{
-				out.emplace_back(std::move(current_string));
-				current_string = {};
-				skip_spaces();
-				matched_space = true;
-				matched_quote = false;
-			}
-			else if (*it == '\\')
-			{
-				matched_quote = false;
-				matched_space = false;
-				++it;
-				if (it != in_end)
-				{
-					current_string += *it;
-					++it;
-				}
-			}
-			else
-			{
-				matched_space = false;
-				matched_quote = false;
-				current_string += *it;
-				++it;
-			}
-
-		} while (it != in_end);
-
-		if (!current_string.empty())
-		{
-			out.emplace_back(std::move(current_string));
-		}
-		else if (matched_quote || matched_space)
-		{
-			out.emplace_back();
-		}
-
-		return out;
-	}
-
-	template <typename TerminalHelper>
-	void terminal<TerminalHelper>::push_message(message &&msg)
-	{
-		try_lock();
-		if (m_logs.size() == m_max_log_len)
-		{
-			m_logs[m_current_log_oldest_idx] = std::move(msg);
-			m_current_log_oldest_idx = (m_current_log_oldest_idx + 1) % m_logs.size();
-		}
-		else
-		{
-			m_logs.emplace_back(std::move(msg));
-		}
-		try_unlock();
-	}
 } // namespace term
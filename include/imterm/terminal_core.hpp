@@ -0,0 +1,256 @@
+#ifndef IMTERM_TERMINAL_CORE_HPP
+#define IMTERM_TERMINAL_CORE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils.hpp"
+#include "misc.hpp"
+#include "log_store.hpp"
+#include "ansi.hpp"
+#include "command_output.hpp"
+#include "message_handle.hpp"
+#include "trace.hpp"
+#include "utf8.hpp"
+
+#ifdef IMTERM_USE_FMT
+#include "fmt/format.h"
+#endif
+
+namespace ImTerm {
+
+#ifdef IMTERM_USE_FMT
+	namespace details {
+		// formats deferred texts (see deferred_text)
+		// as they are formatted while displayed, errors (ie: a negative dynamic width) are written in the text instead of thrown
+		struct fmt_formatter {
+			template <typename... Args>
+			static void format(std::string& out, const char* fmt, const Args&... args) {
+				const std::size_t size = out.size();
+				try {
+					fmt::vformat_to(std::back_inserter(out), fmt, fmt::make_format_args(args...));
+				} catch (const fmt::format_error& error) {
+					out.resize(size);
+					out += "<format error: ";
+					out += error.what();
+					out += '>';
+				}
+			}
+		};
+
+		// FMT_STRING("...") yields an empty class converting to its string literal: the string outlives any message
+		template <typename Format>
+		constexpr bool is_static_format_string = std::is_empty_v<Format> && std::is_constructible_v<fmt::string_view, const Format&>;
+	}
+#endif
+
+	// UI independent part of the terminal: logs, command history, tokenizer, command dispatch and completion
+	// Has no dependency on ImGui: ImTerm::terminal displays a terminal_core, but it can also be driven by other frontends
+	// (ie: stdin/stdout, tests, benchmarks) and run on any thread, as long as a single thread uses it at once
+	// Commands are found and formatted through the TerminalHelper, but are called by the frontend (see execute), as
+	// their arguments depend on it
+	template<typename TerminalHelper>
+	class terminal_core {
+	public:
+		using command_type_cref = typename decltype(std::declval<TerminalHelper&>().list_commands())::value_type;
+		using command_type = typename command_type_cref::type;
+
+		explicit terminal_core(std::shared_ptr<TerminalHelper> th = std::make_shared<TerminalHelper>());
+
+		// Returns the underlying terminal helper
+		const std::shared_ptr<TerminalHelper>& get_terminal_helper() const noexcept {
+			return m_t_helper;
+		}
+
+		// logs a text, added as terminal message with info severity
+		void add_text(std::string str, unsigned int color_beg, unsigned int color_end);
+
+		// logs a text, added as terminal message with warn severity
+		void add_text_err(std::string str, unsigned int color_beg, unsigned int color_end);
+
+		// logs a message, and its structured fields
+		void add_message(message&& msg, std::vector<message::field> fields = {});
+
+		// logs a message that can be updated afterwards, from any thread, through the returned handle
+		message_handle add_updatable_message(message&& msg, std::vector<message::field> fields = {});
+
+#ifdef IMTERM_USE_FMT
+		// logs a message whose text is only formatted from fmt and args once displayed, searched or exported (msg.value is ignored)
+		// fmt must be a compile-time format string, FMT_STRING("..."), and arguments must be numbers or enums (see deferred_text)
+		template <typename Format, typename... Args>
+		void add_deferred_formatted(message&& msg, const Format& fmt, const Args&... args);
+#endif
+
+		// clears the logs
+		void clear();
+
+		// Returns the log store holding the logs
+		const std::shared_ptr<log_store>& get_log_store() const noexcept {
+			return m_store;
+		}
+
+		void set_log_store(std::shared_ptr<log_store> store) noexcept {
+			assert(store != nullptr);
+			m_store = std::move(store);
+		}
+
+		// Returns the stream commands write their output to (see argument_t::out)
+		command_output& output() noexcept {
+			return m_output;
+		}
+
+		// logs the output written by commands since the last call. Call once per frame
+		void flush_output() {
+			m_output.flush(*m_store);
+		}
+
+		// returns the command line history
+		const std::vector<std::string>& get_history() const {
+			load_history();
+			return m_command_history;
+		}
+
+		// Makes the history persistent: the first time the history is used, the entries returned by load are put before it,
+		// and each entry added to it afterwards is passed to save (see history_file, for a history shared between sessions)
+		void set_history_storage(std::function<std::vector<std::string>()> load, std::function<void(std::string_view)> save) {
+			m_load_history = std::move(load);
+			m_save_history = std::move(save);
+		}
+
+		// runs a command line: history references ("!!", "!-2", ...) are resolved, the line is logged and split in arguments,
+		// then the command matching the first argument is called through call(const command_type&, std::vector<std::string>&& arguments)
+		// The resolved line is added to the history. Pending command output is flushed first, to be logged before the line
+		template <typename Call>
+		void execute(std::string_view line, Call&& call);
+
+		// updates the completion for a command line being typed: commands matching the first argument if only it was typed,
+		// arguments returned by complete(const command_type&, std::vector<std::string>& arguments) otherwise
+		// returns true if only the first argument was typed
+		template <typename Complete>
+		bool update_completion(std::string_view line, Complete&& complete);
+
+		// sets the completion to every command (does nothing if it already is)
+		void complete_all_commands() {
+			if (m_all_commands_completed) {
+				return;
+			}
+			m_current_autocomplete = m_t_helper->list_commands();
+			m_current_autocomplete_strings.clear();
+			m_all_commands_completed = true;
+			++m_completion_generation;
+		}
+
+		void clear_completion() noexcept {
+			m_current_autocomplete.clear();
+			m_current_autocomplete_strings.clear();
+			m_all_commands_completed = false;
+			++m_completion_generation;
+		}
+
+		// incremented each time the completion changes, so that views may cache what they display of it
+		unsigned long completion_generation() const noexcept {
+			return m_completion_generation;
+		}
+
+		// commands completing the command line, if any
+		const std::vector<command_type_cref>& command_completion() const noexcept {
+			return m_current_autocomplete;
+		}
+
+		// arguments completing the command line, if any
+		const std::vector<std::string>& argument_completion() const noexcept {
+			return m_current_autocomplete_strings;
+		}
+
+		// lets the helper publish changes made to its commands, see terminal_helper_example::sync_commands
+		// the completion is cleared if they changed, as it refers to the previous commands
+		void sync_commands();
+
+		// number of chars of the space beginning str, 0 if str does not begin with a space
+		int is_space(std::string_view str) const;
+
+		// position of the first space of str, str.size() if there is none
+		std::size_t find_space(std::string_view str) const;
+
+		bool is_digit(char c) const;
+
+		// displayed length of str
+		unsigned long get_length(std::string_view str) const;
+
+		// Returns a vector containing each element that were space separated
+		// Returns an empty optional if a '"' char was not matched with a closing '"',
+		//                except if ignore_non_match was set to true
+		std::optional<std::vector<std::string>> split_by_space(std::string_view in, bool ignore_non_match = false) const;
+
+		// loads the history first, if needed (see set_history_storage)
+		std::optional<std::string> resolve_history_reference(std::string_view str, bool& modified) const;
+
+		std::pair<bool, std::string> resolve_history_references(std::string_view str, bool& modified) const;
+
+	private:
+		// arguments of a history entry, split once when it is added so that history references are slices
+		struct history_tokens {
+			std::string arguments{}; // concatenated
+			std::vector<std::size_t> ends{}; // end of each argument in arguments
+			std::size_t rest_begin{}; // position of the second word in the entry, for "!:*"
+		};
+
+		history_tokens tokenize_history_entry(std::string_view line, const std::vector<std::string>& arguments) const;
+
+		void add_to_history(std::string&& line, history_tokens&& tokens);
+
+		// puts the entries from m_load_history, if any, before the history
+		void load_history() const;
+
+		// requires the history to be loaded
+		std::optional<std::string> resolve_loaded_history_reference(std::string_view str, bool& modified) const noexcept;
+
+		void try_log(std::string_view str, message::type type);
+
+		log_store::seq_type push_message(message&&, std::vector<message::field>&& fields = {});
+
+		mutable std::shared_ptr<TerminalHelper> m_t_helper;
+		std::shared_ptr<log_store> m_store{std::make_shared<log_store>()};
+		mutable std::vector<std::string> m_command_history{};
+		// one per m_command_history entry, entries loaded from m_load_history being tokenized when first referenced
+		mutable std::vector<std::optional<history_tokens>> m_history_tokens{};
+		mutable std::function<std::vector<std::string>()> m_load_history{};
+		std::function<void(std::string_view)> m_save_history{};
+		command_output m_output{};
+
+		// autocompletion
+		std::vector<command_type_cref> m_current_autocomplete{};
+		std::vector<std::string> m_current_autocomplete_strings{};
+		unsigned long m_completion_generation{1u};
+		bool m_all_commands_completed{false};
+	};
+}
+
+#include "terminal_core.tpp"
+
+#endif //IMTERM_TERMINAL_CORE_HPP
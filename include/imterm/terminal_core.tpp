@@ -0,0 +1,794 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+
+namespace ImTerm
+{
+	namespace details
+	{
+		template <typename T>
+		using is_space_method = decltype(std::declval<T &>().is_space(std::declval<std::string_view>()));
+
+		template <typename TerminalHelper>
+		std::enable_if_t<misc::is_detected_v<is_space_method, TerminalHelper>, int> constexpr is_space(std::shared_ptr<TerminalHelper> &t_h, std::string_view str)
+		{
+			static_assert(std::is_same_v<decltype(t_h->is_space(str)), int>, "TerminalHelper::is_space(std::string_view) should return an int");
+			return t_h->is_space(str);
+		}
+
+		template <typename TerminalHelper>
+		std::enable_if_t<!misc::is_detected_v<is_space_method, TerminalHelper>, int> is_space(std::shared_ptr<TerminalHelper> &, std::string_view str)
+		{
+			return utf8::space_size(str);
+		}
+
+		template <typename TerminalHelper>
+		std::enable_if_t<misc::is_detected_v<is_space_method, TerminalHelper>, std::size_t> find_space(std::shared_ptr<TerminalHelper> &t_h, std::string_view str)
+		{
+			for (std::size_t i = 0u; i < str.size(); ++i)
+			{
+				if (is_space(t_h, str.substr(i)) > 0)
+				{
+					return i;
+				}
+			}
+			return str.size();
+		}
+
+		template <typename TerminalHelper>
+		std::enable_if_t<!misc::is_detected_v<is_space_method, TerminalHelper>, std::size_t> find_space(std::shared_ptr<TerminalHelper> &, std::string_view str)
+		{
+			return utf8::find_space(str);
+		}
+
+		template <typename T>
+		using get_length_method = decltype(std::declval<T &>().get_length(std::declval<std::string_view>()));
+
+		template <typename TerminalHelper>
+		std::enable_if_t<misc::is_detected_v<get_length_method, TerminalHelper>, unsigned long> constexpr get_length(std::shared_ptr<TerminalHelper> &t_h, std::string_view str)
+		{
+			static_assert(std::is_same_v<decltype(t_h->get_length(str)), int>, "TerminalHelper::get_length(std::string_view) should return an int");
+			return t_h->get_length(str);
+		}
+
+		template <typename TerminalHelper>
+		std::enable_if_t<!misc::is_detected_v<get_length_method, TerminalHelper>, unsigned long> get_length(std::shared_ptr<TerminalHelper> &, std::string_view str)
+		{
+			return utf8::length(str);
+		}
+
+		// lexer of the history references of a command line (!!, !-n, !:m, !-n:m, !:* and !-n:*)
+		namespace history_lexer
+		{
+			enum class state
+			{
+				nothing,  // matched nothing
+				bang,	  // matched '!'
+				dash,	  // matched !-
+				jump,	  // matched !-[n]
+				colon,	  // matched !-[n]: or !:
+				argument, // matched !-[n]:[m]
+				count
+			};
+
+			enum class char_class
+			{
+				other,
+				bang,
+				dash,
+				colon,
+				star,
+				digit,
+				end, // of the command line
+				count
+			};
+
+			enum class action
+			{
+				none,
+				begin,			// a reference begins with the current char
+				resolve_with,	// the reference ends with the current char
+				resolve_before, // the reference ended before the current char, which is read again
+				quote_before,	// same as resolve_before, the resolved argument being quoted if it contains spaces
+				error
+			};
+
+			struct transition
+			{
+				state next;
+				action act;
+			};
+
+			// transitions[state][char class]
+			constexpr transition transitions[static_cast<int>(state::count)][static_cast<int>(char_class::count)] = {
+				// other, bang, dash, colon, star, digit, end
+				{{state::nothing, action::none}, {state::bang, action::begin}, {state::nothing, action::none}, {state::nothing, action::none}, {state::nothing, action::none}, {state::nothing, action::none}, {state::nothing, action::none}},
+				{{state::nothing, action::none}, {state::nothing, action::resolve_with}, {state::dash, action::none}, {state::colon, action::none}, {state::nothing, action::none}, {state::nothing, action::none}, {state::nothing, action::none}},
+				{{state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::error}, {state::jump, action::none}, {state::nothing, action::error}},
+				{{state::nothing, action::resolve_before}, {state::nothing, action::resolve_before}, {state::nothing, action::resolve_before}, {state::colon, action::none}, {state::nothing, action::resolve_before}, {state::jump, action::none}, {state::nothing, action::resolve_before}},
+				{{state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::error}, {state::nothing, action::resolve_with}, {state::argument, action::none}, {state::nothing, action::error}},
+				{{state::nothing, action::quote_before}, {state::nothing, action::quote_before}, {state::nothing, action::quote_before}, {state::nothing, action::quote_before}, {state::nothing, action::quote_before}, {state::argument, action::none}, {state::nothing, action::quote_before}},
+			};
+		}
+
+		template <typename T>
+		using sync_commands_method = decltype(std::declval<T &>().sync_commands());
+
+		// returns true if the helper's commands changed, meaning references to its previous commands must be dropped
+		template <typename TerminalHelper>
+		std::enable_if_t<misc::is_detected_v<sync_commands_method, TerminalHelper>, bool> sync_commands(TerminalHelper &helper)
+		{
+			static_assert(std::is_same_v<decltype(helper.sync_commands()), bool>, "TerminalHelper::sync_commands() should return a bool");
+			return helper.sync_commands();
+		}
+
+		template <typename TerminalHelper>
+		std::enable_if_t<!misc::is_detected_v<sync_commands_method, TerminalHelper>, bool> sync_commands(TerminalHelper &)
+		{
+			return false;
+		}
+	}
+
+	template <typename TerminalHelper>
+	terminal_core<TerminalHelper>::terminal_core(std::shared_ptr<TerminalHelper> th)
+		: m_t_helper{std::move(th)}
+	{
+		assert(m_t_helper != nullptr);
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::add_text(std::string str, unsigned int color_beg, unsigned int color_end)
+	{
+		message msg;
+		msg.is_term_message = true;
+		msg.severity = message::severity::info;
+		msg.color_beg = color_beg;
+		msg.color_end = color_end;
+		msg.value = std::move(str);
+		push_message(std::move(msg));
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::add_text_err(std::string str, unsigned int color_beg, unsigned int color_end)
+	{
+		message msg;
+		msg.is_term_message = true;
+		msg.severity = message::severity::warn;
+		msg.color_beg = color_beg;
+		msg.color_end = color_end;
+		msg.value = std::move(str);
+		push_message(std::move(msg));
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::add_message(message &&msg, std::vector<message::field> fields)
+	{
+		if (msg.is_term_message && msg.severity != message::severity::warn)
+		{
+			msg.severity = message::severity::info;
+		}
+		push_message(std::move(msg), std::move(fields));
+	}
+
+	template <typename TerminalHelper>
+	message_handle terminal_core<TerminalHelper>::add_updatable_message(message &&msg, std::vector<message::field> fields)
+	{
+		if (msg.is_term_message && msg.severity != message::severity::warn)
+		{
+			msg.severity = message::severity::info;
+		}
+		return {m_store, push_message(std::move(msg), std::move(fields))};
+	}
+
+#ifdef IMTERM_USE_FMT
+	template <typename TerminalHelper>
+	template <typename Format, typename... Args>
+	void terminal_core<TerminalHelper>::add_deferred_formatted(message &&msg, const Format &fmt, const Args &...args)
+	{
+		static_assert(details::is_static_format_string<Format>, "the format string must be checked at compile time: use FMT_STRING");
+		[[maybe_unused]] fmt::format_string<Args...> checked{Format{}}; // compile-time error if args don't match fmt
+		m_store->push_deferred(std::move(msg), deferred_text::make<details::fmt_formatter>(fmt::string_view(fmt).data(), args...));
+	}
+#endif
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::clear()
+	{
+		m_store->clear();
+	}
+
+	template <typename TerminalHelper>
+	template <typename Call>
+	void terminal_core<TerminalHelper>::execute(std::string_view line, Call &&call)
+	{
+		IMTERM_TRACE_SCOPE("terminal_core::execute");
+		clear_completion();
+		flush_output();
+
+		bool modified{};
+		std::pair<bool, std::string> resolved = resolve_history_references(line, modified);
+
+		if (!resolved.first)
+		{
+			try_log(R"(No such event: )" + resolved.second, message::type::error);
+			return;
+		}
+
+		std::optional<std::vector<std::string>> splitted = split_by_space(resolved.second);
+		if (!splitted)
+		{
+			try_log(line, message::type::user_input);
+			try_log("Unmatched \"", message::type::error);
+			return;
+		}
+
+		try_log(line, message::type::user_input);
+		if (splitted->empty())
+		{
+			return;
+		}
+		if (modified)
+		{
+			try_log("> " + resolved.second, message::type::cmd_history_completion);
+		}
+
+		history_tokens tokens = tokenize_history_entry(resolved.second, *splitted);
+		std::vector<command_type_cref> matching_command_list = m_t_helper->find_commands_by_prefix(splitted->front());
+		if (matching_command_list.empty())
+		{
+			splitted->front() += ": command not found";
+			try_log(splitted->front(), message::type::error);
+			add_to_history(std::move(resolved.second), std::move(tokens));
+			return;
+		}
+
+		call(matching_command_list[0].get(), std::move(*splitted));
+		m_output.end_command();
+		add_to_history(std::move(resolved.second), std::move(tokens));
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::add_to_history(std::string &&line, history_tokens &&tokens)
+	{
+		load_history();
+		if (m_save_history)
+		{
+			m_save_history(line);
+		}
+		m_command_history.emplace_back(std::move(line));
+		m_history_tokens.emplace_back(std::move(tokens));
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::load_history() const
+	{
+		if (!m_load_history)
+		{
+			return;
+		}
+		IMTERM_TRACE_SCOPE("terminal_core::load_history");
+		std::vector<std::string> loaded = std::exchange(m_load_history, nullptr)();
+		m_history_tokens.insert(m_history_tokens.begin(), loaded.size(), std::nullopt);
+		m_command_history.insert(m_command_history.begin(), std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.end()));
+	}
+
+	template <typename TerminalHelper>
+	typename terminal_core<TerminalHelper>::history_tokens terminal_core<TerminalHelper>::tokenize_history_entry(std::string_view line, const std::vector<std::string> &arguments) const
+	{
+		history_tokens tokens{};
+		tokens.ends.reserve(arguments.size());
+		for (const std::string &argument : arguments)
+		{
+			tokens.arguments += argument;
+			tokens.ends.push_back(tokens.arguments.size());
+		}
+
+		auto skip_spaces = [&](std::size_t pos)
+		{
+			for (int space; pos < line.size() && (space = is_space(line.substr(pos))) > 0;)
+			{
+				pos += static_cast<std::size_t>(space);
+			}
+			return pos;
+		};
+		const std::size_t first_word = skip_spaces(0u);
+		tokens.rest_begin = skip_spaces(first_word + find_space(line.substr(first_word)));
+		return tokens;
+	}
+
+	template <typename TerminalHelper>
+	template <typename Complete>
+	bool terminal_core<TerminalHelper>::update_completion(std::string_view line, Complete &&complete)
+	{
+		m_all_commands_completed = false;
+		++m_completion_generation;
+
+		int sp_count = 0;
+		auto is_space_lbd = [this, &sp_count, &line](const char &c)
+		{
+			if (sp_count > 0)
+			{
+				--sp_count;
+				return true;
+			}
+			else
+			{
+				sp_count = is_space({&c, static_cast<unsigned>(line.data() + line.size() - &c)});
+				if (sp_count > 0)
+				{
+					--sp_count;
+					return true;
+				}
+				return false;
+			}
+		};
+		const char *beg = std::find_if_not(line.data(), line.data() + line.size(), is_space_lbd);
+		const char *ed = beg + find_space({beg, static_cast<std::size_t>(line.data() + line.size() - beg)});
+
+		if (ed == line.data() + line.size())
+		{
+			IMTERM_TRACE_SCOPE("terminal_core::find_commands_by_prefix");
+			m_current_autocomplete = m_t_helper->find_commands_by_prefix(beg, ed);
+			m_current_autocomplete_strings.clear();
+			return true;
+		}
+
+		m_current_autocomplete.clear();
+		IMTERM_TRACE_SCOPE("terminal_core::complete");
+		std::vector<command_type_cref> cmds = m_t_helper->find_commands_by_prefix(beg, ed);
+
+		if (!cmds.empty())
+		{
+			std::optional<std::vector<std::string>> splitted = split_by_space(line, true);
+			assert(splitted);
+			m_current_autocomplete_strings = complete(cmds[0].get(), *splitted);
+		}
+		return false;
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::sync_commands()
+	{
+		if (details::sync_commands(*m_t_helper))
+		{
+			clear_completion();
+		}
+	}
+
+	template <typename TerminalHelper>
+	std::pair<bool, std::string> terminal_core<TerminalHelper>::resolve_history_references(std::string_view str, bool &modified) const
+	{
+		using namespace details::history_lexer;
+
+		modified = false;
+		if (str.empty())
+		{
+			return {true, {}};
+		}
+
+		if (str.size() == 1)
+		{
+			return {(str[0] != '!'), {str.data(), str.size()}};
+		}
+
+		load_history();
+		std::string ans;
+		ans.reserve(str.size());
+
+		auto resolve = [&](std::string_view history_request, bool add_escaping) -> bool
+		{
+			bool local_modified{};
+			std::optional<std::string> solved = resolve_loaded_history_reference(history_request, local_modified);
+			if (!solved)
+			{
+				return false;
+			}
+
+			modified |= local_modified;
+			if (add_escaping && solved->empty())
+			{
+				ans += R"("")";
+			}
+			else if (add_escaping && find_space(*solved) != solved->size())
+			{
+				ans += '"';
+				ans += *solved;
+				ans += '"';
+			}
+			else
+			{
+				ans += *solved;
+			}
+			return true;
+		};
+
+		auto classify = [this](char c)
+		{
+			switch (c)
+			{
+			case '!':
+				return char_class::bang;
+			case '-':
+				return char_class::dash;
+			case ':':
+				return char_class::colon;
+			case '*':
+				return char_class::star;
+			default:
+				return is_digit(c) ? char_class::digit : char_class::other;
+			}
+		};
+
+		// single pass: chars from literal_begin are either copied as is, or the reference being read
+		std::size_t literal_begin = 0u;
+		std::size_t i = 0u;
+		state current = state::nothing;
+		while (true)
+		{
+			char_class type = char_class::end;
+			if (i < str.size())
+			{
+				if (str[i] == '\\')
+				{
+					// escaped chars are copied as is, along with their '\'
+					do
+					{
+						i = std::min(i + 2u, str.size());
+					} while (i < str.size() && str[i] == '\\');
+					if (current != state::nothing)
+					{
+						return {false, std::string{str.substr(literal_begin, i - literal_begin)}};
+					}
+					continue;
+				}
+				type = classify(str[i]);
+			}
+
+			const transition next = transitions[static_cast<int>(current)][static_cast<int>(type)];
+			switch (next.act)
+			{
+			case action::none:
+				break;
+			case action::begin:
+				ans += str.substr(literal_begin, i - literal_begin);
+				literal_begin = i;
+				break;
+			case action::resolve_with:
+				if (!resolve(str.substr(literal_begin, i + 1u - literal_begin), false))
+				{
+					return {false, std::string{str.substr(literal_begin, i + 1u - literal_begin)}};
+				}
+				literal_begin = i + 1u;
+				break;
+			case action::resolve_before:
+				[[fallthrough]];
+			case action::quote_before:
+				if (!resolve(str.substr(literal_begin, i - literal_begin), next.act == action::quote_before))
+				{
+					return {false, std::string{str.substr(literal_begin, i - literal_begin)}};
+				}
+				literal_begin = i;
+				current = state::nothing;
+				continue; // the current char is read again
+			case action::error:
+				return {false, std::string{str.substr(literal_begin, i - literal_begin)}};
+			}
+
+			current = next.next;
+			if (type == char_class::end)
+			{
+				break;
+			}
+			++i;
+		}
+
+		ans += str.substr(literal_begin);
+		return {true, std::move(ans)};
+	}
+
+	template <typename TerminalHelper>
+	std::optional<std::string> terminal_core<TerminalHelper>::resolve_history_reference(std::string_view str, bool &modified) const
+	{
+		load_history();
+		return resolve_loaded_history_reference(str, modified);
+	}
+
+	template <typename TerminalHelper>
+	std::optional<std::string> terminal_core<TerminalHelper>::resolve_loaded_history_reference(std::string_view str, bool &modified) const noexcept
+	{
+		modified = false;
+
+		if (str.empty() || str[0] != '!')
+		{
+			return std::string{str.begin(), str.end()};
+		}
+
+		if (str.size() < 2)
+		{
+			return {};
+		}
+
+		if (str[1] == '!')
+		{
+			if (m_command_history.empty() || str.size() != 2)
+			{
+				return {};
+			}
+			else
+			{
+				modified = true;
+				return {m_command_history.back()};
+			}
+		}
+
+		// ![stuff]
+		unsigned int backward_jump = 1;
+		unsigned int char_idx = 1;
+		if (str[1] == '-')
+		{
+			if (str.size() <= 2 || !is_digit(str[2]))
+			{
+				return {};
+			}
+
+			unsigned int val{0};
+			std::from_chars_result res = std::from_chars(str.data() + 2, str.data() + str.size(), val, 10);
+			if (val == 0)
+			{
+				return {}; // val == 0  <=> (garbage input || user inputted 0)
+			}
+
+			backward_jump = val;
+			char_idx = static_cast<unsigned int>(res.ptr - str.data());
+		}
+
+		if (m_command_history.size() < backward_jump)
+		{
+			return {};
+		}
+
+		if (char_idx >= str.size())
+		{
+			modified = true;
+			return m_command_history[m_command_history.size() - backward_jump];
+		}
+
+		if (str[char_idx] != ':')
+		{
+			return {};
+		}
+
+		++char_idx;
+		if (str.size() <= char_idx)
+		{
+			return {};
+		}
+
+		// 1 <= backward_jump <= command_history.size()
+		std::optional<history_tokens> &entry_tokens = m_history_tokens[m_history_tokens.size() - backward_jump];
+		if (!entry_tokens)
+		{
+			const std::string &entry = m_command_history[m_command_history.size() - backward_jump];
+			entry_tokens = tokenize_history_entry(entry, split_by_space(entry, true).value_or(std::vector<std::string>{}));
+		}
+		const history_tokens &tokens = *entry_tokens;
+		if (str[char_idx] == '*')
+		{
+			modified = true;
+			return m_command_history[m_command_history.size() - backward_jump].substr(tokens.rest_begin);
+		}
+
+		if (!is_digit(str[char_idx]))
+		{
+			return {};
+		}
+
+		unsigned int val1{};
+		std::from_chars_result res1 = std::from_chars(str.data() + char_idx, str.data() + str.size(), val1, 10);
+		if (!misc::success(res1.ec) || res1.ptr != str.data() + str.size())
+		{ // either unsuccessful or we didn't reach the end of the string
+			return {};
+		}
+
+		if (tokens.ends.size() <= val1)
+		{
+			return {};
+		}
+
+		modified = true;
+		const std::size_t argument_begin = val1 == 0u ? 0u : tokens.ends[val1 - 1u];
+		return tokens.arguments.substr(argument_begin, tokens.ends[val1] - argument_begin);
+	}
+
+	template <typename TerminalHelper>
+	int terminal_core<TerminalHelper>::is_space(std::string_view str) const
+	{
+		return details::is_space(m_t_helper, str);
+	}
+
+	template <typename TerminalHelper>
+	std::size_t terminal_core<TerminalHelper>::find_space(std::string_view str) const
+	{
+		return details::find_space(m_t_helper, str);
+	}
+
+	template <typename TerminalHelper>
+	bool terminal_core<TerminalHelper>::is_digit(char c) const
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	template <typename TerminalHelper>
+	unsigned long terminal_core<TerminalHelper>::get_length(std::string_view str) const
+	{
+		return details::get_length(m_t_helper, str);
+	}
+
+	template <typename TerminalHelper>
+	std::optional<std::vector<std::string>> terminal_core<TerminalHelper>::split_by_space(std::string_view in, bool ignore_non_match) const
+	{
+		std::vector<std::string> out;
+
+		const char *it = &in[0];
+		const char *const in_end = &in[in.size() - 1] + 1;
+
+		auto skip_spaces = [&]()
+		{
+			int space_count;
+			do
+			{
+				space_count = is_space({it, static_cast<unsigned>(in_end - it)});
+				it += space_count;
+			} while (it != in_end && space_count > 0);
+		};
+
+		if (it != in_end)
+		{
+			skip_spaces();
+		}
+
+		if (it == in_end)
+		{
+			return out;
+		}
+
+		bool matched_quote{};
+		bool matched_space{};
+		std::string current_string{};
+		do
+		{
+			if (*it == '"')
+			{
+				bool escaped;
+				do
+				{
+					escaped = (*it == '\\');
+					++it;
+
+					if (it != in_end && (*it != '"' || escaped))
+					{
+						if (*it == '\\')
+						{
+							if (escaped)
+							{
+								current_string += *it;
+							}
+						}
+						else
+						{
+							current_string += *it;
+						}
+					}
+					else
+					{
+						break;
+					}
+
+				} while (true);
+
+				if (it == in_end)
+				{
+					if (!ignore_non_match)
+					{
+						return {};
+					}
+				}
+				else
+				{
+					++it;
+				}
+				matched_quote = true;
+				matched_space = false;
+			}
+			else if (is_space({it, static_cast<unsigned>(in_end - it)}) > 0)
+			{
+				out.emplace_back(std::move(current_string));
+				current_string = {};
+				skip_spaces();
+				matched_space = true;
+				matched_quote = false;
+			}
+			else if (*it == '\\')
+			{
+				matched_quote = false;
+				matched_space = false;
+				++it;
+				if (it != in_end)
+				{
+					current_string += *it;
+					++it;
+				}
+			}
+			else
+			{
+				matched_space = false;
+				matched_quote = false;
+				current_string += *it;
+				++it;
+			}
+
+		} while (it != in_end);
+
+		if (!current_string.empty())
+		{
+			out.emplace_back(std::move(current_string));
+		}
+		else if (matched_quote || matched_space)
+		{
+			out.emplace_back();
+		}
+
+		return out;
+	}
+
+	template <typename TerminalHelper>
+	void terminal_core<TerminalHelper>::try_log(std::string_view str, message::type type)
+	{
+		message::severity::severity_t severity;
+		switch (type)
+		{
+		case message::type::user_input:
+			severity = message::severity::trace;
+			break;
+		case message::type::error:
+			severity = message::severity::err;
+			break;
+		case message::type::cmd_history_completion:
+			severity = message::severity::debug;
+			break;
+		}
+		std::optional<message> msg = m_t_helper->format({str.data(), str.size()}, type);
+		if (msg)
+		{
+			msg->is_term_message = true;
+			msg->severity = severity;
+			push_message(std::move(*msg));
+		}
+	}
+
+	template <typename TerminalHelper>
+	log_store::seq_type terminal_core<TerminalHelper>::push_message(message &&msg, std::vector<message::field> &&fields)
+	{
+		IMTERM_TRACE_SCOPE("terminal_core::push_message");
+		std::vector<message::style_run> styles;
+		ansi::parse(msg, styles);
+		return m_store->push(std::move(msg), std::move(fields), styles);
+	}
+} // namespace ImTerm
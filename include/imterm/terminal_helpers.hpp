@@ -18,10 +18,13 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <set>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <deque>
 
 #include "terminal.hpp"
+#include "command_registry.hpp"
 #if __has_include("spdlog/spdlog.h")
 #include "spdlog/common.h"
 #include "spdlog/formatter.h"
@@ -82,7 +85,7 @@ namespace ImTerm {
 			return {std::move(msg)}; // other fields are ignored
 		}
 
-		// optional : to be friendlier with non ascii encoding
+		// optional : for encodings other than UTF-8 (UTF-8 white spaces are detected by default, see utf8::space_size)
 		// return value : 0 if str does not begin by a space
 		//                otherwise, the number of characters participating in the representation of the beginning space
 		// should not return a value > str.size()
@@ -91,7 +94,7 @@ namespace ImTerm {
 //			return str[0] == ' ';
 //		}
 
-		// optional : to be friendlier with non ascii encoding
+		// optional : for encodings other than UTF-8 (UTF-8 code points are counted by default, see utf8::length)
 		// return value : number of glyphs represented in str (== str.size() for ascii)
 //		unsigned long get_length(std::string_view str) {
 //	      return str.size();
@@ -101,6 +104,12 @@ namespace ImTerm {
 //		void set_terminal(term_t& term) {
 //		}
 
+		// optional : called at the beginning of each frame. Return true if commands were added or removed since the last call:
+		// the terminal then drops the commands it got from find_commands_by_prefix and list_commands
+//		bool sync_commands() {
+//			return false;
+//		}
+
 
 
 		// command samples (implemented as static methods, but they can be outside of a class, if you will to)
@@ -135,7 +144,8 @@ namespace ImTerm {
 	// You may inherit to save some hassle
 	// Template parameter TerminalHelper is in most cases the derived class (and should be if you don't know what to put)
 	// Template parameter Value is the type passed to commands together with the other arguments
-	// You may add commands with the 'add_command_' method.
+	// You may add commands with the 'add_command_' method, and remove them with 'remove_command_'. Both may be called from any
+	// thread (ie: by plugins being loaded), without blocking the terminal (see command_registry)
 	// Refer to terminal_helper_example (see above) for a commented example
 	template <typename TerminalHelper, typename Value>
 	class basic_terminal_helper {
@@ -146,15 +156,31 @@ namespace ImTerm {
 		using argument_type = ImTerm::argument_t<ImTerm::terminal<TerminalHelper>>;
 		using command_type_cref = std::reference_wrapper<const command_type>;
 
+#ifdef IMTERM_ENABLE_TRACING
+		// registers the 'trace' command, writing terminal trace events as Chrome/Perfetto JSON
+		basic_terminal_helper() {
+			add_command_({"trace", "dumps terminal trace events: trace dump <file> | trace clear", trace_command_, trace_completion_});
+		}
+#else
 		basic_terminal_helper() = default;
+#endif
 		basic_terminal_helper(const basic_terminal_helper&) = default;
 		basic_terminal_helper(basic_terminal_helper&&) noexcept = default;
+		basic_terminal_helper& operator=(const basic_terminal_helper&) = default;
+		basic_terminal_helper& operator=(basic_terminal_helper&&) = default;
+
+		// called right after the terminal's construction. A helper's commands are read by a single terminal (see command_registry):
+		// helpers defining their own set_terminal should call this one
+		void set_terminal(term_t& term) noexcept {
+			cmd_list_.bind_reader(&term);
+		}
 
 		std::vector<command_type_cref> find_commands_by_prefix(std::string_view prefix) {
 			auto compare_name = [](const command_type& cmd) { return cmd.name; };
 			auto map_to_cref = [](const command_type& cmd) { return std::cref(cmd); };
 
-			return misc::prefix_search(prefix, cmd_list_.begin(), cmd_list_.end(), std::move(compare_name),
+			const std::vector<command_type>& commands = cmd_list_.current().commands;
+			return misc::prefix_search(prefix, commands.begin(), commands.end(), std::move(compare_name),
 			                           std::move(map_to_cref));
 		}
 
@@ -163,9 +189,10 @@ namespace ImTerm {
 		}
 
 		std::vector<command_type_cref> list_commands() {
+			const std::vector<command_type>& commands = cmd_list_.current().commands;
 			std::vector<command_type_cref> ans;
-			ans.reserve(cmd_list_.size());
-			for (const command_type& cmd : cmd_list_) {
+			ans.reserve(commands.size());
+			for (const command_type& cmd : commands) {
 				ans.emplace_back(cmd);
 			}
 			return ans;
@@ -178,12 +205,55 @@ namespace ImTerm {
 			return {std::move(msg)};
 		}
 
+		// called by the terminal at the beginning of each frame
+		// if it returns true, commands were added or removed since the previous call, and commands previously returned are dropped
+		bool sync_commands() noexcept {
+			return cmd_list_.quiesce();
+		}
+
 	protected:
+		// replaces the command having the same name, if any
 		void add_command_(const command_type& cmd) {
-			cmd_list_.emplace(cmd);
+			cmd_list_.add(cmd);
 		}
 
-		std::set<command_type> cmd_list_{};
+		// returns false if there is no such command
+		bool remove_command_(std::string_view name) {
+			return cmd_list_.remove(name);
+		}
+
+		command_registry<command_type> cmd_list_{};
+
+#ifdef IMTERM_ENABLE_TRACING
+	private:
+		static void trace_command_(argument_type& arg) {
+			const std::vector<std::string>& cl = arg.command_line;
+			if (cl.size() == 3 && cl[1] == "dump") {
+				unsigned long count{};
+				if (trace::dump(cl[2], &count)) {
+					arg.term.add_text("trace: " + std::to_string(count) + " events written to " + cl[2]);
+				} else {
+					arg.term.add_text_err("trace: could not write to " + cl[2]);
+				}
+			} else if (cl.size() == 2 && cl[1] == "clear") {
+				trace::clear();
+			} else {
+				arg.term.add_text_err("usage: trace dump <file> | trace clear");
+			}
+		}
+
+		static std::vector<std::string> trace_completion_(argument_type& arg) {
+			std::vector<std::string> ans;
+			if (arg.command_line.size() == 2) {
+				for (std::string_view sub : {std::string_view{"clear"}, std::string_view{"dump"}}) {
+					if (sub.substr(0, arg.command_line[1].size()) == arg.command_line[1]) {
+						ans.emplace_back(sub);
+					}
+				}
+			}
+			return ans;
+		}
+#endif
 	};
 
 #ifdef IMTERM_SPDLOG_INCLUDED
@@ -216,6 +286,10 @@ namespace ImTerm {
 			, terminal_{std::exchange(other.terminal_, nullptr)}
 			, terminal_formatter_{std::move(other.terminal_formatter_)}
 			, logger_name_{std::move(other.logger_name_)}
+			, sync_level_{other.sync_level_}
+			, terminal_log_level_{other.terminal_log_level_}
+			, kept_records_capacity_{other.kept_records_capacity_}
+			, kept_records_{std::move(other.kept_records_)}
 		{
 			SinkBase::set_level(other.level());
 			SinkBase::set_formatter(std::move(other.formatter_));
@@ -236,6 +310,7 @@ namespace ImTerm {
 		// this method is called automatically right after ImTerm::terminal's construction
 		// used to sink logs to the message panel
 		void set_terminal(term_t& term) {
+			TermHBase::set_terminal(term);
 			terminal_ = &term;
 		}
 
@@ -250,6 +325,31 @@ namespace ImTerm {
 			set_terminal_formatter_(std::move(terminal_formatter), type);
 		}
 
+		// keeps the sink's level in sync with the terminal's log level, so that records it would not display are dropped before
+		// being formatted. The sink's level is then managed by the terminal
+		// if kept_records is not 0, the last kept_records dropped records are instead kept unformatted, and logged as soon as the
+		// log level is lowered enough to display them
+		void sync_sink_level(bool enabled, std::size_t kept_records = 0u) {
+			std::lock_guard<Mutex> lock(SinkBase::mutex_);
+			sync_level_ = enabled;
+			kept_records_capacity_ = enabled ? kept_records : 0u;
+			if (enabled) {
+				apply_terminal_log_level_();
+			} else {
+				SinkBase::set_level(spdlog::level::trace);
+				kept_records_.clear();
+			}
+		}
+
+		// this method is called automatically by the terminal when its log level changes
+		void set_terminal_log_level(message::severity::severity_t level) {
+			std::lock_guard<Mutex> lock(SinkBase::mutex_);
+			terminal_log_level_ = level;
+			if (sync_level_) {
+				apply_terminal_log_level_();
+			}
+		}
+
 	protected:
 
 		void set_terminal_pattern_(const std::string& pattern, ImTerm::message::type type) {
@@ -265,17 +365,88 @@ namespace ImTerm {
 				return;
 			}
 			assert(terminal_ != nullptr);
-            spdlog::memory_buf_t buff{};
+			if (sync_level_ && details::to_imterm_severity(msg.level) < terminal_log_level_) {
+				// only reached if records are kept (the sink's level filters them otherwise)
+				kept_records_.push_back({msg.time, msg.source, msg.thread_id, msg.level,
+				                         terminal_->get_log_store()->intern_channel({msg.logger_name.data(), msg.logger_name.size()}),
+				                         {msg.payload.data(), msg.payload.size()}});
+				if (kept_records_.size() > kept_records_capacity_) {
+					kept_records_.pop_front();
+				}
+				return;
+			}
+			log_to_terminal_(msg);
+		}
+
+		// replayed records are labeled (see apply_terminal_log_level_)
+		void log_to_terminal_(const spdlog::details::log_msg& msg, bool replayed = false) {
+			constexpr std::string_view replayed_prefix = "[replayed] ";
+			spdlog::memory_buf_t buff{};
+			if (replayed) { // before formatting, which sets the color range as offsets in buff
+				buff.append(replayed_prefix.data(), replayed_prefix.data() + replayed_prefix.size());
+			}
 			SinkBase::formatter_->format(msg, buff);
+			const auto channel = terminal_->get_log_store()->intern_channel({msg.logger_name.data(), msg.logger_name.size()});
+			std::vector<message::field> fields{};
+			if (!msg.source.empty()) {
+				fields.push_back({"file", msg.source.filename ? msg.source.filename : ""});
+				fields.push_back({"line", std::to_string(msg.source.line)});
+				fields.push_back({"function", msg.source.funcname ? msg.source.funcname : ""});
+			}
+			if (replayed) {
+				const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(spdlog::log_clock::now() - msg.time);
+				fields.push_back({"replayed_after_ms", std::to_string(delay.count())});
+			}
 			terminal_->add_message({details::to_imterm_severity(msg.level), fmt::to_string(buff)
-								 , msg.color_range_start, msg.color_range_end, false});
+								 , msg.color_range_start, msg.color_range_end, false, channel}, std::move(fields));
 		}
 
 		void flush_() override {}
 
+		// requires the sink's mutex
+		void apply_terminal_log_level_() {
+			// if records are kept, those below the terminal's level are filtered by sink_it_
+			SinkBase::set_level(kept_records_capacity_ == 0u ? details::to_spdlog_severity(terminal_log_level_) : spdlog::level::trace);
+
+			// logging the kept records that are now displayed, in order
+			// the log store timestamps them now, after the messages logged in the meantime: they are labeled as replayed, the
+			// original time being kept in their text (if the sink's pattern has it) and their replayed_after_ms field
+			auto displayed = std::stable_partition(kept_records_.begin(), kept_records_.end(), [this](const kept_record_& record) {
+				return details::to_imterm_severity(record.level) < terminal_log_level_;
+			});
+			std::for_each(displayed, kept_records_.end(), [this](const kept_record_& record) {
+				std::string logger_name;
+				{
+					std::lock_guard lock{*terminal_->get_log_store()};
+					logger_name = terminal_->get_log_store()->channel_name(record.channel);
+				}
+				spdlog::details::log_msg msg(record.time, record.source, logger_name, record.level, record.payload);
+				msg.thread_id = record.thread_id;
+				log_to_terminal_(msg, true);
+			});
+			kept_records_.erase(displayed, kept_records_.end());
+			while (kept_records_.size() > kept_records_capacity_) {
+				kept_records_.pop_front();
+			}
+		}
+
+		// record dropped because of the terminal's log level, unformatted
+		struct kept_record_ {
+			spdlog::log_clock::time_point time;
+			spdlog::source_loc source;
+			std::size_t thread_id;
+			spdlog::level::level_enum level;
+			log_store::channel_type channel;
+			std::string payload;
+		};
+
 		term_t* terminal_{};
 		std::array<std::unique_ptr<spdlog::formatter>, 3> terminal_formatter_{}; // user_input, error, cmd_history_completion (c.f. ImTerm::message::type)
 		std::string logger_name_;
+		bool sync_level_{false};
+		message::severity::severity_t terminal_log_level_{message::severity::trace};
+		std::size_t kept_records_capacity_{0u};
+		std::deque<kept_record_> kept_records_{};
 	};
 
 
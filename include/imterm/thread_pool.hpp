@@ -0,0 +1,155 @@
+#ifndef IMTERM_THREAD_POOL_HPP
+#define IMTERM_THREAD_POOL_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ImTerm {
+
+	// Small work-stealing thread pool running parallel loops.
+	// Task indices are split in one contiguous range per participating thread (the workers, and the thread calling run).
+	// Each thread goes through its own range, then steals remaining tasks from the other ranges.
+	class thread_pool {
+	public:
+		explicit thread_pool(unsigned worker_count = default_worker_count()) : m_slots{std::make_unique<slot[]>(worker_count + 1)} {
+			m_workers.reserve(worker_count);
+			for (unsigned i = 0; i < worker_count; ++i) {
+				m_workers.emplace_back([this, i]() { work(i); });
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool() {
+			{
+				std::lock_guard lock{m_mutex};
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (std::thread& worker : m_workers) {
+				worker.join();
+			}
+		}
+
+		static unsigned default_worker_count() noexcept {
+			const unsigned hardware = std::thread::hardware_concurrency();
+			return hardware > 1u ? hardware - 1u : 0u;
+		}
+
+		unsigned worker_count() const noexcept {
+			return static_cast<unsigned>(m_workers.size());
+		}
+
+		// calls fn(i) for every i in [0, task_count), returning once every call returned. fn should not throw
+		// only one loop runs at a time: concurrent calls are serialized
+		template <typename Function>
+		void run(std::size_t task_count, Function&& fn) {
+			std::lock_guard run_lock{m_run_mutex};
+			const std::size_t participants = m_workers.size() + 1u;
+			if (task_count <= 1u || participants == 1u) {
+				for (std::size_t i = 0u; i < task_count; ++i) {
+					fn(i);
+				}
+				return;
+			}
+
+			for (std::size_t i = 0u; i < participants; ++i) {
+				m_slots[i].next.store(task_count * i / participants, std::memory_order_relaxed);
+				m_slots[i].end = task_count * (i + 1u) / participants;
+			}
+			{
+				std::lock_guard lock{m_mutex};
+				m_function = const_cast<void*>(static_cast<const void*>(&fn));
+				m_call = [](void* function, std::size_t i) {
+					(*static_cast<std::remove_reference_t<Function>*>(function))(i);
+				};
+				m_running = m_workers.size();
+				++m_generation;
+			}
+			m_wake.notify_all();
+
+			execute(m_workers.size());
+
+			std::unique_lock lock{m_mutex};
+			m_done.wait(lock, [this]() { return m_running == 0u; });
+		}
+
+	private:
+		struct alignas(64) slot {
+			std::atomic<std::size_t> next{0u};
+			std::size_t end{0u};
+		};
+
+		void work(unsigned self) {
+			unsigned long seen_generation = 0u;
+			std::unique_lock lock{m_mutex};
+			while (true) {
+				m_wake.wait(lock, [&]() { return m_stop || m_generation != seen_generation; });
+				if (m_stop) {
+					return;
+				}
+				seen_generation = m_generation;
+				lock.unlock();
+				execute(self);
+				lock.lock();
+				if (--m_running == 0u) {
+					m_done.notify_one();
+				}
+			}
+		}
+
+		// runs tasks from the thread's own range, then from the others'
+		void execute(std::size_t self) {
+			const std::size_t participants = m_workers.size() + 1u;
+			for (std::size_t offset = 0u; offset < participants; ++offset) {
+				slot& victim = m_slots[(self + offset) % participants];
+				for (std::size_t i = victim.next.fetch_add(1u, std::memory_order_relaxed); i < victim.end;
+				     i = victim.next.fetch_add(1u, std::memory_order_relaxed)) {
+					m_call(m_function, i);
+				}
+			}
+		}
+
+		std::vector<std::thread> m_workers{};
+		std::unique_ptr<slot[]> m_slots;
+
+		std::mutex m_run_mutex{};
+		std::mutex m_mutex{};
+		std::condition_variable m_wake{};
+		std::condition_variable m_done{};
+		unsigned long m_generation{0u};
+		std::size_t m_running{0u};
+		bool m_stop{false};
+
+		void* m_function{nullptr};
+		void (*m_call)(void*, std::size_t){nullptr};
+	};
+}
+
+#endif //IMTERM_THREAD_POOL_HPP
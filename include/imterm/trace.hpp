@@ -0,0 +1,220 @@
+#ifndef IMTERM_TRACE_HPP
+#define IMTERM_TRACE_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Compile-time opt-in tracing of the terminal internals
+// Define IMTERM_ENABLE_TRACING before including any ImTerm header to enable it. When it is not defined,
+// IMTERM_TRACE_SCOPE expands to nothing and this header declares nothing else.
+//
+// Events are recorded in a per-thread ring buffer (one writer per buffer, no lock), and can be exported
+// as Chrome trace-event JSON (readable by chrome://tracing and https://ui.perfetto.dev) with ImTerm::trace::dump.
+// Timestamps come from std::chrono::steady_clock unless you supply your own time source with
+// ImTerm::trace::set_time_source, which lets you correlate terminal events with the rest of your frame.
+
+#ifdef IMTERM_ENABLE_TRACING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#ifndef IMTERM_TRACE_BUFFER_SIZE
+#define IMTERM_TRACE_BUFFER_SIZE 16384 // number of events kept per thread
+#endif
+
+namespace ImTerm::trace {
+
+	// returns the current time, in nanoseconds
+	using time_source = std::int64_t (*)();
+
+	namespace details {
+		inline std::int64_t steady_now() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		inline std::atomic<time_source>& current_time_source() {
+			static std::atomic<time_source> source{steady_now};
+			return source;
+		}
+
+		// fields are atomics so that dumping while another thread is recording is well defined
+		// (relaxed stores compile down to plain stores on common architectures)
+		struct event {
+			std::atomic<const char*> name{nullptr};
+			std::atomic<std::int64_t> begin{0};
+			std::atomic<std::int64_t> duration{0};
+		};
+
+		// single producer (the owning thread), any number of readers
+		struct thread_buffer {
+			std::array<event, IMTERM_TRACE_BUFFER_SIZE> events{};
+			std::atomic<std::uint64_t> written{0};
+			std::uint32_t thread_id{};
+			thread_buffer* next{nullptr};
+
+			void record(const char* name, std::int64_t begin, std::int64_t duration) noexcept {
+				const std::uint64_t idx = written.load(std::memory_order_relaxed);
+				event& ev = events[idx % events.size()];
+				ev.name.store(name, std::memory_order_relaxed);
+				ev.begin.store(begin, std::memory_order_relaxed);
+				ev.duration.store(duration, std::memory_order_relaxed);
+				written.store(idx + 1, std::memory_order_release);
+			}
+		};
+
+		// buffers are only ever added (lock-free push), and deliberately leaked: threads may still record (and the registry be
+		// dumped) while static objects are destroyed
+		struct registry {
+			std::atomic<thread_buffer*> head{nullptr};
+			std::atomic<std::uint32_t> thread_count{0};
+
+			thread_buffer* create_buffer() {
+				auto* buffer = new thread_buffer;
+				buffer->thread_id = ++thread_count;
+				buffer->next = head.load(std::memory_order_relaxed);
+				while (!head.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {}
+				return buffer;
+			}
+		};
+
+		inline registry& global_registry() {
+			static registry reg;
+			return reg;
+		}
+
+		inline thread_buffer& local_buffer() {
+			thread_local thread_buffer* buffer = global_registry().create_buffer();
+			return *buffer;
+		}
+
+		inline void append_json_escaped(std::string& out, const char* str) {
+			for (; *str != '\0' ; ++str) {
+				if (*str == '"' || *str == '\\') {
+					out += '\\';
+				}
+				if (static_cast<unsigned char>(*str) >= 0x20) {
+					out += *str;
+				}
+			}
+		}
+	}
+
+	// sets the clock used to timestamp events. Pass nullptr to restore the default steady_clock based one
+	inline void set_time_source(time_source source) noexcept {
+		details::current_time_source().store(source == nullptr ? details::steady_now : source);
+	}
+
+	inline std::int64_t now() noexcept {
+		return details::current_time_source().load(std::memory_order_relaxed)();
+	}
+
+	// records a complete event. 'name' must have static storage duration
+	inline void record(const char* name, std::int64_t begin, std::int64_t duration) noexcept {
+		details::local_buffer().record(name, begin, duration);
+	}
+
+	// RAII helper recording the time spent in its scope
+	class scope {
+	public:
+		explicit scope(const char* name) noexcept : m_name{name}, m_begin{now()} {}
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope() {
+			record(m_name, m_begin, now() - m_begin);
+		}
+
+	private:
+		const char* m_name;
+		std::int64_t m_begin;
+	};
+
+	// drops every recorded event. Events recorded concurrently might or might not be dropped
+	inline void clear() noexcept {
+		for (auto* buffer = details::global_registry().head.load(std::memory_order_acquire) ; buffer != nullptr ; buffer = buffer->next) {
+			for (details::event& ev : buffer->events) {
+				ev.name.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// returns the recorded events as a Chrome trace-event JSON document
+	inline std::string to_json(unsigned long* event_count = nullptr) {
+		std::string out = R"({"displayTimeUnit":"ns","traceEvents":[)";
+		unsigned long count = 0;
+		char number[64];
+
+		for (auto* buffer = details::global_registry().head.load(std::memory_order_acquire) ; buffer != nullptr ; buffer = buffer->next) {
+			const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+			const std::uint64_t size = buffer->events.size();
+			for (std::uint64_t i = written > size ? written - size : 0u ; i < written ; ++i) {
+				const details::event& ev = buffer->events[i % size];
+				const char* name = ev.name.load(std::memory_order_relaxed);
+				if (name == nullptr) {
+					continue;
+				}
+				const std::int64_t begin = ev.begin.load(std::memory_order_relaxed);
+				const std::int64_t duration = ev.duration.load(std::memory_order_relaxed);
+
+				if (count++ != 0) {
+					out += ',';
+				}
+				out += R"({"name":")";
+				details::append_json_escaped(out, name);
+				std::snprintf(number, sizeof(number), R"(","cat":"imterm","ph":"X","pid":0,"tid":%u,)", buffer->thread_id);
+				out += number;
+				std::snprintf(number, sizeof(number), R"("ts":%.3f,"dur":%.3f})", static_cast<double>(begin) / 1000., static_cast<double>(duration) / 1000.);
+				out += number;
+			}
+		}
+		out += "]}";
+
+		if (event_count != nullptr) {
+			*event_count = count;
+		}
+		return out;
+	}
+
+	// writes the recorded events to 'path' as a Chrome trace-event JSON document
+	// returns false if the file could not be written
+	inline bool dump(const std::string& path, unsigned long* event_count = nullptr) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+		const std::string json = to_json(event_count);
+		file.write(json.data(), static_cast<std::streamsize>(json.size()));
+		return static_cast<bool>(file);
+	}
+}
+
+#define IMTERM_TRACE_CONCAT_(a, b) a##b
+#define IMTERM_TRACE_CONCAT(a, b) IMTERM_TRACE_CONCAT_(a, b)
+#define IMTERM_TRACE_SCOPE(name) ::ImTerm::trace::scope IMTERM_TRACE_CONCAT(imterm_trace_scope_, __LINE__){name}
+
+#else
+
+#define IMTERM_TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
+
+#endif //IMTERM_TRACE_HPP
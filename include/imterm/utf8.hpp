@@ -0,0 +1,236 @@
+#ifndef IMTERM_UTF8_HPP
+#define IMTERM_UTF8_HPP
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///                                                                                                                                     ///
+///  Copyright C 2019, Lucas Lazare                                                                                                     ///
+///  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation         ///
+///  files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy,         ///
+///  modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software     ///
+///  is furnished to do so, subject to the following conditions:                                                                        ///
+///                                                                                                                                     ///
+///  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.     ///
+///                                                                                                                                     ///
+///  The Software is provided “as is”, without warranty of any kind, express or implied, including but not limited to the               ///
+///  warranties of merchantability, fitness for a particular purpose and noninfringement. In no event shall the authors or              ///
+///  copyright holders be liable for any claim, damages or other liability, whether in an action of contract, tort or otherwise,        ///
+///  arising from, out of or in connection with the software or the use or other dealings in the Software.                              ///
+///                                                                                                                                     ///
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#include <cstddef>
+#include <string_view>
+
+#include "search.hpp"
+
+namespace ImTerm::utf8 {
+
+	// UTF-8 primitives working on whole strings, used by default to tokenize command lines and measure them
+	// (see TerminalHelper::is_space and TerminalHelper::get_length)
+	// ASCII spans are skipped a whole vector at a time (AVX2 if the CPU supports it, SSE2 otherwise on x86)
+
+	namespace details {
+		constexpr unsigned char byte(char c) noexcept {
+			return static_cast<unsigned char>(c);
+		}
+
+		inline std::size_t length_scalar(const char* data, std::size_t size) noexcept {
+			std::size_t count = 0u;
+			for (std::size_t i = 0u; i < size; ++i) {
+				count += (byte(data[i]) & 0xC0u) != 0x80u ? 1u : 0u;
+			}
+			return count;
+		}
+
+#ifdef IMTERM_SEARCH_X86
+		// bytes that are not continuation bytes (0x80 - 0xBF) are counted, in 8 bits counters summed every 255 blocks
+		inline std::size_t length_sse2(const char* data, std::size_t size) noexcept {
+			std::size_t count = 0u;
+			std::size_t i = 0u;
+			while (i + 16u <= size) {
+				__m128i counters = _mm_setzero_si128();
+				for (int blocks = 0; blocks < 255 && i + 16u <= size; ++blocks, i += 16u) {
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+					counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(block, _mm_set1_epi8(static_cast<char>(0xBF))));
+				}
+				const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+				count += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) + static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+			}
+			return count + length_scalar(data + i, size - i);
+		}
+
+		// position of the first byte of str that is not ASCII, starting at from
+		inline std::size_t ascii_end_sse2(std::string_view str, std::size_t from) noexcept {
+			std::size_t i = from;
+			for (; i + 16u <= str.size(); i += 16u) {
+				const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i))));
+				if (mask != 0u) {
+					return i + search::details::lowest_bit(mask);
+				}
+			}
+			while (i < str.size() && byte(str[i]) < 0x80u) {
+				++i;
+			}
+			return i;
+		}
+
+		// position of the first byte of str that is a control char, a space or not ASCII, starting at from
+		inline std::size_t space_candidate_sse2(std::string_view str, std::size_t from) noexcept {
+			std::size_t i = from;
+			for (; i + 16u <= str.size(); i += 16u) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+				const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmplt_epi8(block, _mm_set1_epi8(' ' + 1))));
+				if (mask != 0u) {
+					return i + search::details::lowest_bit(mask);
+				}
+			}
+			while (i < str.size() && byte(str[i]) > ' ' && byte(str[i]) < 0x80u) {
+				++i;
+			}
+			return i;
+		}
+
+#ifdef IMTERM_SEARCH_AVX2
+		__attribute__((target("avx2"))) inline std::size_t length_avx2(const char* data, std::size_t size) noexcept {
+			std::size_t count = 0u;
+			std::size_t i = 0u;
+			while (i + 32u <= size) {
+				__m256i counters = _mm256_setzero_si256();
+				for (int blocks = 0; blocks < 255 && i + 32u <= size; ++blocks, i += 32u) {
+					const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+					counters = _mm256_sub_epi8(counters, _mm256_cmpgt_epi8(block, _mm256_set1_epi8(static_cast<char>(0xBF))));
+				}
+				const __m256i sums = _mm256_sad_epu8(counters, _mm256_setzero_si256());
+				count += static_cast<std::size_t>(_mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+			}
+			return count + length_sse2(data + i, size - i);
+		}
+#endif
+#endif
+
+		inline std::size_t ascii_end(std::string_view str, std::size_t from) noexcept {
+#ifdef IMTERM_SEARCH_X86
+			return ascii_end_sse2(str, from);
+#else
+			while (from < str.size() && byte(str[from]) < 0x80u) {
+				++from;
+			}
+			return from;
+#endif
+		}
+
+		inline std::size_t space_candidate(std::string_view str, std::size_t from) noexcept {
+#ifdef IMTERM_SEARCH_X86
+			return space_candidate_sse2(str, from);
+#else
+			while (from < str.size() && byte(str[from]) > ' ' && byte(str[from]) < 0x80u) {
+				++from;
+			}
+			return from;
+#endif
+		}
+	}
+
+	// number of code points of str. Continuation bytes are not counted, even if str is not valid UTF-8
+	inline std::size_t length(std::string_view str) noexcept {
+#ifdef IMTERM_SEARCH_AVX2
+		if (search::details::has_avx2()) {
+			return details::length_avx2(str.data(), str.size());
+		}
+#endif
+#ifdef IMTERM_SEARCH_X86
+		return details::length_sse2(str.data(), str.size());
+#else
+		return details::length_scalar(str.data(), str.size());
+#endif
+	}
+
+	// number of bytes of the white space (as defined by Unicode, ie: ' ', '\t', U+00A0 or U+3000) beginning str, 0 if str
+	// does not begin with a white space
+	inline int space_size(std::string_view str) noexcept {
+		if (str.empty()) {
+			return 0;
+		}
+		const unsigned char lead = details::byte(str[0]);
+		if (lead < 0x80u) {
+			return lead == ' ' || (lead >= '\t' && lead <= '\r') ? 1 : 0;
+		}
+		if (lead == 0xC2u && str.size() >= 2u) {
+			const unsigned char next = details::byte(str[1]);
+			return next == 0x85u || next == 0xA0u ? 2 : 0; // U+0085, U+00A0
+		}
+		if (lead < 0xE1u || lead > 0xE3u || str.size() < 3u) {
+			return 0;
+		}
+		const unsigned code_point = (lead & 0x0Fu) << 12u | (details::byte(str[1]) & 0x3Fu) << 6u | (details::byte(str[2]) & 0x3Fu);
+		if ((details::byte(str[1]) & 0xC0u) != 0x80u || (details::byte(str[2]) & 0xC0u) != 0x80u) {
+			return 0;
+		}
+		const bool space = code_point == 0x1680u || (code_point >= 0x2000u && code_point <= 0x200Au) || code_point == 0x2028u
+		                   || code_point == 0x2029u || code_point == 0x202Fu || code_point == 0x205Fu || code_point == 0x3000u;
+		return space ? 3 : 0;
+	}
+
+	// position of the first white space of str (see space_size) starting at from, or str.size() if there is none
+	inline std::size_t find_space(std::string_view str, std::size_t from = 0u) noexcept {
+		for (std::size_t i = details::space_candidate(str, from); i < str.size(); i = details::space_candidate(str, i + 1u)) {
+			if (space_size(str.substr(i)) > 0) {
+				return i;
+			}
+		}
+		return str.size();
+	}
+
+	// whether str is valid UTF-8: no overlong encoding, surrogate, code point above U+10FFFF or truncated sequence
+	inline bool valid(std::string_view str) noexcept {
+		std::size_t i = details::ascii_end(str, 0u);
+		while (i < str.size()) {
+			const unsigned char lead = details::byte(str[i]);
+			if (lead < 0x80u) {
+				i = details::ascii_end(str, i);
+				continue;
+			}
+
+			// allowed range of the second byte, which rules out overlong encodings, surrogates and code points above U+10FFFF
+			unsigned char low = 0x80u;
+			unsigned char high = 0xBFu;
+			std::size_t continuations;
+			if (lead >= 0xC2u && lead <= 0xDFu) {
+				continuations = 1u;
+			} else if (lead >= 0xE0u && lead <= 0xEFu) {
+				continuations = 2u;
+				low = lead == 0xE0u ? 0xA0u : low;
+				high = lead == 0xEDu ? 0x9Fu : high;
+			} else if (lead >= 0xF0u && lead <= 0xF4u) {
+				continuations = 3u;
+				low = lead == 0xF0u ? 0x90u : low;
+				high = lead == 0xF4u ? 0x8Fu : high;
+			} else {
+				return false;
+			}
+
+			if (str.size() - i <= continuations) {
+				return false;
+			}
+			const unsigned char second = details::byte(str[i + 1u]);
+			if (second < low || second > high) {
+				return false;
+			}
+			for (std::size_t j = 2u; j <= continuations; ++j) {
+				if ((details::byte(str[i + j]) & 0xC0u) != 0x80u) {
+					return false;
+				}
+			}
+			i += continuations + 1u;
+		}
+		return true;
+	}
+
+	// whether c is a continuation byte, ie: not the first byte of a code point
+	constexpr bool is_continuation(char c) noexcept {
+		return (details::byte(c) & 0xC0u) == 0x80u;
+	}
+}
+
+#endif //IMTERM_UTF8_HPP
@@ -18,16 +18,20 @@
 ///                                                                                                                                     ///
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <array>
 #include <optional>
 #include <array>
-#include <imgui.h>
 
 #include "misc.hpp"
 
+struct ImVec4; // defined by imgui.h, which is only needed by the terminal's view
+
 namespace ImTerm {
+	class command_output;
+
 	// argument passed to commands
 	template<typename Terminal>
 	struct argument_t {
@@ -37,6 +41,11 @@ namespace ImTerm {
 		Terminal& term; // reference to the ImTerm::terminal that called the command
 
 		std::vector<std::string> command_line; // list of arguments the user specified in the command line. command_line[0] is the command name
+
+		// stream logging the command's output, lines being logged in bulk at the next frame (see command_output)
+		command_output& out() const {
+			return term.output();
+		}
 	};
 
 	// structure used to represent a command
@@ -71,6 +80,28 @@ namespace ImTerm {
 			error,                  // terminal wants to log an error in user input
 			cmd_history_completion, // terminal wants to log that it replaced "!:*" family input in the appropriate string
 		};
+		// structured key/value data attached to a message, which can be queried from the filter (ie: "latency_ms>50")
+		struct field {
+			std::string key;
+			std::string value;
+		};
+		// colors and style of a range of a message's text, parsed from its ANSI escape sequences when it is logged (see ansi.hpp)
+		struct style_run {
+			enum flag : std::uint8_t {
+				bold = 1u << 0u,
+				dim = 1u << 1u,
+				italic = 1u << 2u, // parsed, but not rendered
+				underline = 1u << 3u,
+				inverse = 1u << 4u,
+				strikethrough = 1u << 5u,
+			};
+
+			std::uint32_t begin; // text range [begin, end)
+			std::uint32_t end;
+			std::uint32_t foreground; // 0xAARRGGBB, 0 for the default color
+			std::uint32_t background; // 0xAARRGGBB, 0 for none
+			std::uint8_t flags;
+		};
 		struct severity {
 			enum severity_t { // done this way to be used as array index without a cast
 				trace,
@@ -93,15 +124,24 @@ namespace ImTerm {
 		bool is_term_message; // if set to true, current msg is considered to be originated from the terminal,
 		// never filtered out by severity filter, and applying for different rules regarding colors.
 		// severity is also ignored for such messages
+
+		std::uint32_t channel{0u}; // channel the message belongs to, as returned by log_store::intern_channel. 0 for none
+
+		float progress{-1.f}; // progress of an operation in [0, 1], drawn behind the message. Negative for none (see message_handle)
 	};
 
 	enum class config_panels {
 		autoscroll,
 		autowrap,
+		match_case, // checkbox making the filter case sensitive or not
 		clearbutton,
 		filter,
 		long_filter, // like filter, but takes up space
 		loglevel,
+		channel, // drop down list selecting the displayed channel. Hidden while no channel exists
+		timestamps, // checkbox showing how long ago messages were logged
+		time_window, // input restricting the display to messages of the last seconds
+		goto_time, // input scrolling back to a given time (ie: "-30s")
 		blank, // invisible panel that takes up place, aligning items to the right. More than one can be used, splitting up the consumed space
 		// ie: {clearbutton (C), blank, filter (F), blank, loglevel (L)} will result in the layout [C           F           L]
 		// Shares space with long_filter
@@ -120,7 +160,8 @@ namespace ImTerm {
 		struct constexpr_color {
 			float r,g,b,a;
 
-			ImVec4 imv4() const {
+			template <typename Vec4 = ::ImVec4>
+			Vec4 imv4() const {
 				return {r,g,b,a};
 			}
 		};